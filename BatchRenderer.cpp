@@ -0,0 +1,144 @@
+#include "BatchRenderer.h"
+
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <type_traits>
+
+#include "Formulas.h"
+#include "PixelStepper.h"
+#include "SimdKernels.h"
+
+BatchRenderer::BatchRenderer(const Settings &settings)
+    : m_settings{settings},
+      m_palette{settings.scheme, settings.maxIterations, settings.smooth}
+{
+    const QSize &size = m_settings.size;
+    m_view = FractalRect::centered(m_settings.center, m_settings.width, QRectF{0, 0, static_cast<qreal>(size.width()), static_cast<qreal>(size.height())});
+    // the render works with as many digits as the view needs, however many the settings came with
+    m_view.setPrecision(m_view.requiredDigits());
+    PrecisionGuard precisionGuard{m_view.precision()};
+    m_precision = m_view.requiredPrecision();
+
+    if (usesPerturbation(m_settings.formula, m_settings.deepZoom, m_precision))
+        m_perturbation = std::make_unique<ViewPerturbation>(m_view, m_settings.formula, m_settings.juliaConstant, m_settings.maxIterations,
+                                                            nullptr, m_settings.orbit, m_settings.extendedOrbit);
+}
+
+bool BatchRenderer::render(const std::function<bool(const QRgb *pixels, const float *values)> &writeRow)
+{
+    const int imageWidth = m_settings.size.width();
+    const int imageHeight = m_settings.size.height();
+    const int bandHeight = TileScheduler::tileSize;
+
+    // one band gets calculated while the one before it is colored and written out, which keeps the cores busy while
+    // the (single threaded) compression runs
+    std::vector<float> bands[2];
+    std::vector<QRgb> line(imageWidth);
+    QFuture<bool> writing;
+    bool isWriting = false;
+    for (int top = 0, band = 0; top < imageHeight; top += bandHeight, band ^= 1)
+    {
+        const int height = std::min(bandHeight, imageHeight - top);
+        auto &values = bands[band];
+        values.resize(static_cast<size_t>(imageWidth) * height);
+        calculate(QRect{0, top, imageWidth, height}, values.data());
+
+        if (isWriting && !writing.result())
+            return false;
+        writing = QtConcurrent::run([this, &writeRow, &values, &line, imageWidth, height] {
+            for (int row = 0; row < height; ++row)
+            {
+                const float *rowValues = values.data() + static_cast<size_t>(row) * imageWidth;
+                m_palette.colorize(rowValues, line.data(), imageWidth);
+                if (!writeRow(line.data(), rowValues))
+                    return false;
+            }
+            return true;
+        });
+        isWriting = true;
+    }
+
+    return !isWriting || writing.result();
+}
+
+void BatchRenderer::calculate(const QRect &area, float *values)
+{
+    m_scheduler.run(TileScheduler::tiles(area.size()), m_settings.threads, [&](const QRect &tile) {
+        PrecisionGuard precisionGuard{m_view.precision()};
+        if (m_perturbation)
+            m_perturbation->visit([&](const auto &perturbation, const auto &spacing) {
+                renderPerturbedTile(perturbation, spacing, tile, area, values);
+            });
+        else
+        {
+            switch (m_precision)
+            {
+            case Precision::Double:
+                renderDirectTile<double>(tile, area, values);
+                break;
+            case Precision::LongDouble:
+                renderDirectTile<long double>(tile, area, values);
+                break;
+#ifdef FRACTURE_HAS_FLOAT128
+            case Precision::Float128:
+                renderDirectTile<__float128>(tile, area, values);
+                break;
+#endif
+            default:
+                renderDirectTile<big_float>(tile, area, values);
+                break;
+            }
+        }
+    });
+}
+
+template<typename T>
+void BatchRenderer::renderDirectTile(const QRect &tile, const QRect &area, float *values)
+{
+    // the same stepping as FractalView::renderDirectFragment()
+    PixelStepper<T> stepper{m_view};
+    const T &stepReal = stepper.spacing();
+    const KernelParameters<T> parameters{scalar_cast<T>(m_settings.juliaConstant.real()), scalar_cast<T>(m_settings.juliaConstant.imag()),
+                                         m_settings.maxIterations, periodTolerance(stepReal)};
+
+    visitFormula(m_settings.formula, [&](auto formula) {
+        using F = decltype(formula);
+        // plain doubles get the vectorized kernels, a row of the tile at a time
+        std::vector<double> reals;
+        std::vector<double> imags;
+        for (int j = tile.top(); j < tile.top() + tile.height(); ++j)
+        {
+            float *results = values + static_cast<size_t>(j) * area.width() + tile.left();
+            const T &imag = stepper.imag(area.top() + j);
+            if constexpr (std::is_same_v<T, double> && F::info.vectorized)
+            {
+                reals.resize(tile.width());
+                imags.assign(tile.width(), imag);
+                for (int i = 0; i < tile.width(); ++i)
+                    reals[i] = stepper.real(area.left() + tile.left() + i);
+                calculatePoints(F::info.id, reals.data(), imags.data(), parameters.juliaReal, parameters.juliaImag, parameters.maxIterations,
+                                parameters.periodTolerance, tile.width(), results);
+            }
+            else
+            {
+                for (int i = 0; i < tile.width(); ++i)
+                    results[i] = F::calculatePoint(stepper.real(area.left() + tile.left() + i), imag, parameters);
+            }
+        }
+    });
+}
+
+template<typename D>
+void BatchRenderer::renderPerturbedTile(const Perturbation<D> &perturbation, const D &spacing, const QRect &tile, const QRect &area,
+                                        float *values)
+{
+    const QPointF &referencePixel = m_perturbation->referencePixel();
+    for (int j = tile.top(); j < tile.top() + tile.height(); ++j)
+    {
+        float *results = values + static_cast<size_t>(j) * area.width() + tile.left();
+        const D deltaImag = (area.top() + j - referencePixel.y()) * spacing;
+        for (int i = 0; i < tile.width(); ++i)
+            results[i] = perturbation.calculatePoint((area.left() + tile.left() + i - referencePixel.x()) * spacing, deltaImag);
+    }
+}
@@ -0,0 +1,80 @@
+#ifndef BATCHRENDERER_H
+#define BATCHRENDERER_H
+
+#include <QRect>
+#include <QRgb>
+#include <QSize>
+#include <QThread>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "Common.h"
+#include "FractalRect.h"
+#include "Kernels.h"
+#include "Palette.h"
+#include "Perturbation.h"
+#include "TileScheduler.h"
+
+// Renders a view without any GUI, for the fracture-render tool. The image is calculated one band of tiles at a time,
+// and every finished row is handed on (normally to a PngWriter) before the next band starts, so memory use depends on
+// the width of the image but never on its height.
+class BatchRenderer
+{
+public:
+    struct Settings
+    {
+        Formula formula{Formula::Mandelbrot};
+        complex center{-0.5, 0};
+        // the distance the image spans along the real axis; the imaginary axis follows from the aspect ratio
+        big_float width{4};
+        QSize size{1920, 1080};
+        int maxIterations{defaultMaxIterations};
+        // the same default as the viewer's
+        complex juliaConstant{0.63982341, 0.123432153};
+        Palette::Scheme scheme{Palette::Classic};
+        bool smooth{true};
+        // track pixels as offsets from a reference orbit once the view needs more precision than long double
+        bool deepZoom{true};
+        // reference orbits of center, computed ahead of time for at least maxIterations so that several renders (like
+        // the frames of a zoom sequence) can share them; the renderer computes its own if they're left empty
+        std::shared_ptr<const ReferenceOrbit<double>> orbit;
+        std::shared_ptr<const ReferenceOrbit<long double>> extendedOrbit;
+        int threads{QThread::idealThreadCount()};
+    };
+
+    explicit BatchRenderer(const Settings &settings);
+
+    // the scalar type the render will end up using
+    Precision precision() const { return m_precision; }
+    // the decimal digits its MPFR values have, for the pixels themselves or for the reference orbit of a deep zoom
+    unsigned digits() const { return m_view.precision(); }
+
+    // renders the image and calls writeRow for every row of it, from top to bottom, with both its colors and the
+    // smoothed iteration counts they came from. Rows are written on a separate thread while the next band is being
+    // calculated. Returns false as soon as writeRow does.
+    bool render(const std::function<bool(const QRgb *pixels, const float *values)> &writeRow);
+
+    // calculates the smoothed iteration counts of area (in pixels of the image) into values, row by row, on all of the
+    // renderer's threads; render() does this a band at a time, a render farm worker for the tiles it gets sent
+    void calculate(const QRect &area, float *values);
+
+private:
+    // tile is relative to area, and values holds the whole area
+    template<typename T>
+    void renderDirectTile(const QRect &tile, const QRect &area, float *values);
+    template<typename D>
+    void renderPerturbedTile(const Perturbation<D> &perturbation, const D &spacing, const QRect &tile, const QRect &area, float *values);
+
+    Settings m_settings;
+    FractalRect m_view;
+    Precision m_precision;
+    Palette m_palette;
+    TileScheduler m_scheduler;
+
+    // deep zooms only
+    std::unique_ptr<ViewPerturbation> m_perturbation;
+};
+
+#endif // BATCHRENDERER_H
@@ -0,0 +1,445 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStringList>
+#include <QTextStream>
+#include <QThread>
+
+#include <gmp.h>
+
+#include <algorithm>
+#include <atomic>
+#include <type_traits>
+#include <vector>
+
+#include "BatchRenderer.h"
+#include "Buddhabrot.h"
+#include "Formulas.h"
+#include "FractalRect.h"
+#include "Kernels.h"
+#include "PixelStepper.h"
+#include "SimdKernels.h"
+
+// fracture-bench times the kernels, the mapping from pixels to the fractal plane and whole frames on a fixed set of
+// views, and prints the results as JSON so that runs on different commits can be compared.
+//
+// Rates are given in pixels (or points, or for the orbit densities samples) and iterations per second, with the
+// iterations counted by iterationsSpent().
+// Every measurement also counts the heap allocations GMP and MPFR made during it; the MPFR kernels and the pixel
+// stepping are supposed to make none, which --check-allocations turns into the exit code.
+
+namespace
+{
+
+struct View
+{
+    const char *name;
+    const char *real;
+    const char *imag;
+    const char *width;
+};
+
+// the deep views zoom in on c = i, which lies on the boundary of the Mandelbrot set (it's a Misiurewicz point) and is
+// exactly representable, so there's detail at any depth without needing a center with hundreds of digits
+const View views[] = {
+    {"shallow", "-0.5", "0", "4"},
+    {"1e-10", "0", "1", "1e-10"},
+    {"1e-30", "0", "1", "1e-30"},
+    {"1e-100", "0", "1", "1e-100"},
+};
+
+// the size the views are laid out at for the kernel and mapping benchmarks; it sets the pixel spacing the periodicity
+// check is tuned for and the precision a view needs
+const QSize kernelViewSize{1920, 1080};
+// the kernel benchmarks run over a grid of this many by this many points spread over the view
+constexpr int gridSize = 64;
+
+// the same default constant as the viewer's
+const complex juliaConstant{0.63982341, 0.123432153};
+
+struct Measurement
+{
+    qint64 points{0};
+    qint64 iterations{0};
+    double seconds{0};
+    qint64 allocations{0};
+};
+
+QJsonObject toJson(const Measurement &measurement)
+{
+    return QJsonObject{{"points", measurement.points},
+                       {"iterations", measurement.iterations},
+                       {"seconds", measurement.seconds},
+                       {"pixelsPerSecond", measurement.points / measurement.seconds},
+                       {"iterationsPerSecond", measurement.iterations / measurement.seconds},
+                       {"allocations", measurement.allocations},
+                       {"allocationsPerPoint", static_cast<double>(measurement.allocations) / measurement.points}};
+}
+
+// every MPFR number lives in memory GMP hands out, so wrapping GMP's allocation functions counts them all
+std::atomic<qint64> allocationCount{0};
+void *(*gmpAllocate)(size_t);
+void *(*gmpReallocate)(void *, size_t, size_t);
+void (*gmpFree)(void *, size_t);
+
+void *countingAllocate(size_t size)
+{
+    ++allocationCount;
+    return gmpAllocate(size);
+}
+
+void *countingReallocate(void *pointer, size_t oldSize, size_t newSize)
+{
+    ++allocationCount;
+    return gmpReallocate(pointer, oldSize, newSize);
+}
+
+void countAllocations()
+{
+    mp_get_memory_functions(&gmpAllocate, &gmpReallocate, &gmpFree);
+    mp_set_memory_functions(countingAllocate, countingReallocate, gmpFree);
+}
+
+// the view laid out at size, with as many digits as it needs, like the renderers have it
+FractalRect makeView(const View &view, const QSize &size)
+{
+    auto rect = FractalRect::centered(complex{parseDecimal(view.real), parseDecimal(view.imag)}, parseDecimal(view.width),
+                                      QRectF{0, 0, static_cast<qreal>(size.width()), static_cast<qreal>(size.height())});
+    rect.setPrecision(rect.requiredDigits());
+    return rect;
+}
+
+// runs one row of the grid after another (starting over at the top if need be) until minSeconds have passed;
+// calculateRow is handed the index of a row and has to return how many iterations it took. The first row runs once
+// beforehand, so that setting up thread local scratch space doesn't count as an allocation of the loop.
+template<typename Calculator>
+Measurement measure(double minSeconds, const Calculator &calculateRow)
+{
+    calculateRow(0);
+
+    Measurement measurement;
+    const qint64 allocations = allocationCount;
+    QElapsedTimer timer;
+    timer.start();
+    for (int row = 0; measurement.points == 0 || timer.nsecsElapsed() < minSeconds * 1e9; row = (row + 1) % gridSize)
+    {
+        measurement.iterations += calculateRow(row);
+        measurement.points += gridSize;
+    }
+    measurement.seconds = timer.nsecsElapsed() / 1e9;
+    measurement.allocations = allocationCount - allocations;
+    return measurement;
+}
+
+template<typename T>
+Measurement benchmarkKernel(Formula formula, const FractalRect &view, int maxIterations, bool vectorized, double minSeconds)
+{
+    // the points are converted up front, so that only the kernel itself gets timed
+    const auto &vr = view.visualRect();
+    std::vector<T> reals;
+    std::vector<T> imags;
+    for (int j = 0; j < gridSize; ++j)
+    {
+        for (int i = 0; i < gridSize; ++i)
+        {
+            const auto point = view.getFractalValueFromVisualPoint((i + 0.5) * vr.width() / gridSize, (j + 0.5) * vr.height() / gridSize);
+            reals.push_back(scalar_cast<T>(point.real()));
+            imags.push_back(scalar_cast<T>(point.imag()));
+        }
+    }
+    const T spacing = scalar_cast<T>(big_float{view.width() / vr.width()});
+    const KernelParameters<T> parameters{scalar_cast<T>(juliaConstant.real()), scalar_cast<T>(juliaConstant.imag()), maxIterations,
+                                         periodTolerance(spacing)};
+
+    std::vector<float> results(gridSize);
+    return measure(minSeconds, [&](int row) {
+        const T *real = reals.data() + row * gridSize;
+        const T *imag = imags.data() + row * gridSize;
+        if constexpr (std::is_same_v<T, double>)
+        {
+            if (vectorized)
+            {
+                calculatePoints(formula, real, imag, parameters.juliaReal, parameters.juliaImag, maxIterations, parameters.periodTolerance,
+                                gridSize, results.data());
+                qint64 iterations = 0;
+                for (float value : results)
+                    iterations += iterationsSpent(value, maxIterations);
+                return iterations;
+            }
+        }
+
+        qint64 iterations = 0;
+        visitFormula(formula, [&](auto kernel) {
+            for (int i = 0; i < gridSize; ++i)
+                iterations += iterationsSpent(kernel.calculatePoint(real[i], imag[i], parameters), maxIterations);
+        });
+        return iterations;
+    });
+}
+
+Measurement benchmarkMapping(const FractalRect &view, double minSeconds)
+{
+    const auto &vr = view.visualRect();
+    return measure(minSeconds, [&](int row) {
+        for (int i = 0; i < gridSize; ++i)
+            view.getFractalValueFromVisualPoint((i + 0.5) * vr.width() / gridSize, (row + 0.5) * vr.height() / gridSize);
+        return qint64{0};
+    });
+}
+
+// what the renderers do instead of the mapping above: step across the pixels in MPFR, which is the worst case
+Measurement benchmarkStepping(const FractalRect &view, double minSeconds)
+{
+    PixelStepper<big_float> stepper{view};
+    big_float sum{0};
+    return measure(minSeconds, [&](int row) {
+        const auto &imag = stepper.imag(row);
+        for (int i = 0; i < gridSize; ++i)
+            sum += stepper.real(i);
+        sum += imag;
+        return qint64{0};
+    });
+}
+
+Measurement benchmarkFrame(const View &view, const QSize &size, int threads, Precision &precision)
+{
+    BatchRenderer::Settings settings;
+    settings.center = complex{parseDecimal(view.real), parseDecimal(view.imag)};
+    settings.width = parseDecimal(view.width);
+    settings.size = size;
+    settings.maxIterations = autoIterationBudget(settings.width);
+    settings.threads = threads;
+
+    Measurement measurement;
+    const qint64 allocations = allocationCount;
+    QElapsedTimer timer;
+    timer.start();
+    // setting up the renderer computes the reference orbit for deep zooms, which is part of what a frame costs
+    BatchRenderer renderer{settings};
+    precision = renderer.precision();
+    renderer.render([&](const QRgb *, const float *values) {
+        for (int i = 0; i < size.width(); ++i)
+            measurement.iterations += iterationsSpent(values[i], settings.maxIterations);
+        return true;
+    });
+    measurement.seconds = timer.nsecsElapsed() / 1e9;
+    measurement.points = static_cast<qint64>(size.width()) * size.height();
+    measurement.allocations = allocationCount - allocations;
+    return measurement;
+}
+
+// the Buddhabrot of the Mandelbrot set, in batches like the viewer's, until minSeconds have passed; the points are the
+// orbits it iterated
+Measurement benchmarkDensity(const FractalRect &view, bool anti, int threads, double minSeconds, bool &importanceSampling)
+{
+    Buddhabrot::Settings settings;
+    settings.juliaConstant = juliaConstant;
+    settings.maxIterations = autoIterationBudget(view.width());
+    settings.anti = anti;
+    settings.threads = threads;
+    Buddhabrot buddhabrot{view, settings};
+    importanceSampling = buddhabrot.importanceSampling();
+
+    constexpr qint64 batch = 1 << 16;
+    Measurement measurement;
+    QElapsedTimer timer;
+    timer.start();
+    while (buddhabrot.samples() == 0 || timer.nsecsElapsed() < minSeconds * 1e9)
+        buddhabrot.sample(batch);
+    measurement.seconds = timer.nsecsElapsed() / 1e9;
+    measurement.points = buddhabrot.samples();
+    measurement.iterations = buddhabrot.iterations();
+    return measurement;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("fracture-bench");
+    countAllocations();
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Benchmarks the fracture kernels and renderer and prints the results as JSON.");
+    parser.addHelpOption();
+    const QCommandLineOption viewOption{"view", "Only run this view (shallow, 1e-10, 1e-30 or 1e-100); may be given more than once.", "name"};
+    const QCommandLineOption minTimeOption{"min-time", "How long to run every kernel benchmark for, in seconds.", "seconds", "0.5"};
+    const QCommandLineOption sizeOption{"size", "A frame size to render; may be given more than once.", "WxH"};
+    const QCommandLineOption threadsOption{"threads", "A thread count to render frames with; may be given more than once.", "count"};
+    const QCommandLineOption noFramesOption{"no-frames", "Skip the frame and orbit density renders."};
+    const QCommandLineOption outputOption{"output", "Write the results to this file instead of stdout.", "file"};
+    const QCommandLineOption checkAllocationsOption{"check-allocations",
+                                                    "Fail if the MPFR kernels or the pixel stepping allocate while they run."};
+    parser.addOptions({viewOption, minTimeOption, sizeOption, threadsOption, noFramesOption, outputOption, checkAllocationsOption});
+    parser.process(app);
+
+    QTextStream err{stderr};
+    const double minSeconds = parser.value(minTimeOption).toDouble();
+
+    QVector<QSize> sizes;
+    for (const auto &value : parser.values(sizeOption))
+    {
+        const auto parts = value.split('x');
+        if (parts.size() == 2)
+            sizes.push_back(QSize{parts[0].toInt(), parts[1].toInt()});
+    }
+    if (sizes.isEmpty())
+        sizes = {QSize{640, 360}, QSize{1920, 1080}};
+
+    QVector<int> threadCounts;
+    for (const auto &value : parser.values(threadsOption))
+        threadCounts.push_back(std::max(value.toInt(), 1));
+    if (threadCounts.isEmpty())
+    {
+        for (int threads = 1; threads < QThread::idealThreadCount(); threads *= 2)
+            threadCounts.push_back(threads);
+        threadCounts.push_back(QThread::idealThreadCount());
+    }
+
+    QJsonArray kernels;
+    QJsonArray mappings;
+    QJsonArray frames;
+    QJsonArray densities;
+    // the benchmarks that should never allocate but did
+    QStringList allocating;
+    for (const auto &view : views)
+    {
+        if (parser.isSet(viewOption) && !parser.values(viewOption).contains(view.name))
+            continue;
+
+        const auto rect = makeView(view, kernelViewSize);
+        const int maxIterations = autoIterationBudget(rect.width());
+        const auto required = rect.requiredPrecision();
+
+        for (const auto &info : formulas())
+        {
+            auto addKernel = [&](Precision precision, bool vectorized, const Measurement &measurement) {
+                auto result = toJson(measurement);
+                result["view"] = view.name;
+                result["formula"] = info.name;
+                result["precision"] = precisionName(precision);
+                if (precision == Precision::MultiPrecision)
+                    result["digits"] = static_cast<int>(rect.precision());
+                result["vectorized"] = vectorized;
+                result["maxIterations"] = maxIterations;
+                // the cheaper types still get timed on the deep views, but their pictures would be wrong
+                result["sufficient"] = precision >= required;
+                kernels.push_back(result);
+                if (precision == Precision::MultiPrecision && measurement.allocations > 0)
+                    allocating.push_back(QString{view.name} + " " + info.name + " kernel");
+                err << view.name << " " << info.name << " " << precisionName(precision) << (vectorized ? " (vectorized)" : "")
+                    << ": " << measurement.points / measurement.seconds << " points/s\n";
+                err.flush();
+            };
+
+            if (info.vectorized)
+                addKernel(Precision::Double, true, benchmarkKernel<double>(info.id, rect, maxIterations, true, minSeconds));
+            addKernel(Precision::Double, false, benchmarkKernel<double>(info.id, rect, maxIterations, false, minSeconds));
+            addKernel(Precision::LongDouble, false, benchmarkKernel<long double>(info.id, rect, maxIterations, false, minSeconds));
+#ifdef FRACTURE_HAS_FLOAT128
+            addKernel(Precision::Float128, false, benchmarkKernel<__float128>(info.id, rect, maxIterations, false, minSeconds));
+#endif
+            addKernel(Precision::MultiPrecision, false, benchmarkKernel<big_float>(info.id, rect, maxIterations, false, minSeconds));
+        }
+
+        auto addMapping = [&](const char *method, const Measurement &measurement) {
+            auto mapping = toJson(measurement);
+            mapping.remove("iterations");
+            mapping.remove("iterationsPerSecond");
+            mapping["view"] = view.name;
+            mapping["method"] = method;
+            mappings.push_back(mapping);
+        };
+        addMapping("getFractalValueFromVisualPoint", benchmarkMapping(rect, minSeconds));
+        const auto stepping = benchmarkStepping(rect, minSeconds);
+        addMapping("PixelStepper", stepping);
+        if (stepping.allocations > 0)
+            allocating.push_back(QString{view.name} + " pixel stepping");
+
+        if (parser.isSet(noFramesOption))
+            continue;
+
+        // the orbits are iterated in double, which can still tell the pixels of the views down to 1e-10 apart
+        if (big_float{rect.width() / kernelViewSize.width()} > 1e-15)
+        {
+            for (int threads : threadCounts)
+            {
+                for (bool anti : {false, true})
+                {
+                    bool importanceSampling;
+                    const auto measurement = benchmarkDensity(rect, anti, threads, minSeconds, importanceSampling);
+                    auto density = toJson(measurement);
+                    density.remove("pixelsPerSecond");
+                    density.remove("allocations");
+                    density.remove("allocationsPerPoint");
+                    density["samplesPerSecond"] = measurement.points / measurement.seconds;
+                    density["view"] = view.name;
+                    density["anti"] = anti;
+                    density["threads"] = threads;
+                    // zoomed in, the samples come from Metropolis-Hastings rather than uniformly
+                    density["importanceSampling"] = importanceSampling;
+                    densities.push_back(density);
+                    err << view.name << (anti ? " anti-Buddhabrot" : " Buddhabrot") << " on " << threads
+                        << " threads: " << measurement.points / measurement.seconds << " samples/s\n";
+                    err.flush();
+                }
+            }
+        }
+
+        for (const auto &size : sizes)
+        {
+            for (int threads : threadCounts)
+            {
+                Precision precision;
+                const auto measurement = benchmarkFrame(view, size, threads, precision);
+                auto frame = toJson(measurement);
+                frame["view"] = view.name;
+                frame["width"] = size.width();
+                frame["height"] = size.height();
+                frame["threads"] = threads;
+                frame["precision"] = precisionName(precision);
+                // the frame renderer switches to perturbation where the direct kernels would need __float128 or more
+                frame["perturbation"] = precision >= Precision::Float128;
+                frames.push_back(frame);
+                err << view.name << " " << size.width() << "x" << size.height() << " on " << threads << " threads: " << measurement.seconds
+                    << " s\n";
+                err.flush();
+            }
+        }
+    }
+
+    const QJsonObject results{{"instructionSet", simdInstructionSet()},
+                              {"idealThreadCount", QThread::idealThreadCount()},
+                              {"minSeconds", minSeconds},
+                              {"kernels", kernels},
+                              {"mapping", mappings},
+                              {"frames", frames},
+                              {"densities", densities}};
+    const auto json = QJsonDocument{results}.toJson();
+    if (!parser.isSet(outputOption))
+    {
+        QTextStream{stdout} << json;
+    }
+    else
+    {
+        QFile output{parser.value(outputOption)};
+        if (!output.open(QIODevice::WriteOnly) || output.write(json) != json.size())
+        {
+            err << "fracture-bench: could not write " << output.fileName() << "\n";
+            return 1;
+        }
+    }
+
+    if (parser.isSet(checkAllocationsOption) && !allocating.isEmpty())
+    {
+        for (const auto &name : allocating)
+            err << "fracture-bench: " << name << " allocated memory\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,276 @@
+#include "Buddhabrot.h"
+
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+#include "Formulas.h"
+
+namespace
+{
+// the walkers only switch to Metropolis-Hastings once the view is this many times narrower than the region the samples
+// come from; up to there, enough uniform samples hit it
+constexpr double importanceZoom = 4;
+// how often a walker jumps to a fresh point instead of mutating the one it's at, which keeps it from getting stuck on
+// one island of orbits
+constexpr double freshPointChance = 0.2;
+// the mutations go anywhere from this fraction of the view's width up to all of it, spread evenly over the scales
+// in between, since how far a starting point can move and still hit the same pixels varies wildly from orbit to orbit
+constexpr double smallestMutation = 1e-4;
+// a much tighter tolerance than the escape-time kernels' (see PeriodicityCheck), since mistaking a slow escape for a
+// cycle would lose one of the long orbits that make up most of the picture
+constexpr double periodTolerance = 1e-20;
+// the fixed points the orbits pile up on get far more hits than anything else, so the tone mapping takes this
+// percentile of the pixels that got hit as white, and clips the few past it
+constexpr double whitePercentile = 0.995;
+// the values the tone mapping goes up to; the gradient palettes go from their darkest color to their brightest over
+// the first half of their cycle, and the classic one has done most of its brightening by then
+constexpr float toneRange = 16;
+
+// whether F has an escape-time step, as opposed to Newton's fractal
+template<typename F, typename = void>
+struct HasEscapeStep : std::false_type
+{};
+
+template<typename F>
+struct HasEscapeStep<F, std::void_t<decltype(F::step(std::declval<double &>(), std::declval<double &>(), std::declval<const double &>(),
+                                                     std::declval<const double &>()))>> : std::true_type
+{};
+
+// calls work with every thread index up to count, each on a thread of its own, one of which is the calling thread; the
+// same way TileScheduler::run() does it
+template<typename Work>
+void runThreads(int count, const Work &work)
+{
+    QVector<QFuture<void>> helpers;
+    for (int thread = 1; thread < count; ++thread)
+        helpers.push_back(QtConcurrent::run([&work, thread] { work(thread); }));
+    work(0);
+    for (auto &helper : helpers)
+        helper.waitForFinished();
+}
+}
+
+bool Buddhabrot::supports(Formula formula)
+{
+    bool escapes = false;
+    visitFormula(formula, [&](auto kernel) { escapes = HasEscapeStep<decltype(kernel)>::value; });
+    return escapes;
+}
+
+Buddhabrot::Buddhabrot(const FractalRect &view, const Settings &settings)
+    : m_settings{settings},
+      m_size{view.visualRect().size().toSize()}
+{
+    const auto origin = view.getFractalValueFromVisualPoint(0, 0);
+    m_originReal = origin.real().convert_to<double>();
+    m_originImag = origin.imag().convert_to<double>();
+    m_scaleX = big_float{view.visualRect().width() / view.width()}.convert_to<double>();
+    m_scaleY = big_float{view.visualRect().height() / view.height()}.convert_to<double>();
+    m_viewWidth = view.width().convert_to<double>();
+    m_juliaReal = m_settings.juliaConstant.real().convert_to<double>();
+    m_juliaImag = m_settings.juliaConstant.imag().convert_to<double>();
+
+    const auto &region = formulaInfo(m_settings.formula).initialView;
+    m_region = QRectF{region.left, region.top, region.width, region.height};
+    m_importance = m_viewWidth * importanceZoom < m_region.width();
+
+    // every walker gets a seed of its own, but the same one every time, so the same view comes out the same
+    const size_t bins = static_cast<size_t>(std::max(m_size.width(), 0)) * std::max(m_size.height(), 0);
+    m_walkers.resize(static_cast<size_t>(std::max(m_settings.threads, 1)));
+    for (size_t i = 0; i < m_walkers.size(); ++i)
+    {
+        m_walkers[i].histogram.assign(bins, 0);
+        m_walkers[i].random.seed(static_cast<std::uint64_t>(i));
+    }
+    m_histogram.assign(bins, 0);
+}
+
+bool Buddhabrot::sample(qint64 samples, const std::atomic<bool> *cancelled, RenderTelemetry *telemetry)
+{
+    const int threads = static_cast<int>(m_walkers.size());
+    runThreads(threads, [&](int thread) {
+        auto &walker = m_walkers[static_cast<size_t>(thread)];
+        RenderTelemetry::Event event;
+        if (telemetry)
+            event = telemetry->start("orbits");
+        const qint64 samplesBefore = walker.samples;
+        const qint64 iterationsBefore = walker.iterations;
+
+        const qint64 share = samples / threads + (thread < samples % threads ? 1 : 0);
+        visitFormula(m_settings.formula, [&](auto kernel) {
+            if constexpr (HasEscapeStep<decltype(kernel)>::value)
+                walk<decltype(kernel)>(walker, share, cancelled);
+        });
+
+        if (telemetry)
+        {
+            event.samples = walker.samples - samplesBefore;
+            event.iterations = walker.iterations - iterationsBefore;
+            event.calculating = telemetry->elapsed() - event.start;
+            telemetry->finish(event);
+        }
+    });
+
+    // the reduction: every thread adds up its own stretch of all the walkers' histograms, and clears them for the next
+    // batch while it's at it
+    RenderTelemetry::Event event;
+    if (telemetry)
+        event = telemetry->start("histogram reduction");
+    const size_t bins = m_histogram.size();
+    runThreads(threads, [&](int thread) {
+        const size_t first = bins * thread / threads;
+        const size_t end = bins * (thread + 1) / threads;
+        for (auto &walker : m_walkers)
+        {
+            for (size_t i = first; i < end; ++i)
+                m_histogram[i] += walker.histogram[i];
+            std::fill(walker.histogram.begin() + first, walker.histogram.begin() + end, 0.0f);
+        }
+    });
+    if (telemetry)
+        telemetry->finish(event);
+
+    m_samples = 0;
+    m_iterations = 0;
+    for (const auto &walker : m_walkers)
+    {
+        m_samples += walker.samples;
+        m_iterations += walker.iterations;
+    }
+    return !cancelled || !cancelled->load(std::memory_order_relaxed);
+}
+
+void Buddhabrot::toneMap(float *values) const
+{
+    std::vector<double> counts;
+    for (double count : m_histogram)
+        if (count > 0)
+            counts.push_back(count);
+
+    double whitePoint = 0;
+    if (!counts.empty())
+    {
+        const auto white = counts.begin() + static_cast<std::ptrdiff_t>(static_cast<double>(counts.size() - 1) * whitePercentile);
+        std::nth_element(counts.begin(), white, counts.end());
+        whitePoint = *white;
+    }
+
+    // linear, since every orbit that escapes at all leaves a few hits scattered all over the view; anything that lifts
+    // the faint end (a square root, say) turns those into a gray haze over the whole picture
+    for (size_t i = 0; i < m_histogram.size(); ++i)
+        values[i] = m_histogram[i] > 0 ? toneRange * static_cast<float>(std::min(m_histogram[i] / whitePoint, 1.0)) : 0;
+}
+
+template<typename F>
+void Buddhabrot::walk(Walker &walker, qint64 samples, const std::atomic<bool> *cancelled) const
+{
+    std::uniform_real_distribution<double> unit;
+    for (qint64 n = 0; n < samples; ++n)
+    {
+        // an Anti-Buddhabrot orbit can take a million iterations, so this checks after every one of them
+        if (cancelled && cancelled->load(std::memory_order_relaxed))
+            return;
+        ++walker.samples;
+
+        double real;
+        double imag;
+        if (!m_importance)
+        {
+            randomPoint(walker, real, imag);
+            if (trace<F>(real, imag, walker.proposal, walker.iterations))
+                for (int pixel : walker.proposal)
+                    walker.histogram[static_cast<size_t>(pixel)] += 1;
+            continue;
+        }
+
+        // until the chain has found an orbit that hits the view, it keeps trying fresh points
+        if (walker.hits.empty() || unit(walker.random) < freshPointChance)
+        {
+            randomPoint(walker, real, imag);
+        }
+        else
+        {
+            const double radius = m_viewWidth * std::pow(smallestMutation, unit(walker.random));
+            real = walker.real + radius * (2 * unit(walker.random) - 1);
+            imag = walker.imag + radius * (2 * unit(walker.random) - 1);
+        }
+
+        // both kinds of move are as likely one way as the other, so the odds of taking one are just the ratio of hits
+        if (inRegion(real, imag) && trace<F>(real, imag, walker.proposal, walker.iterations) && !walker.proposal.empty() &&
+                (walker.hits.empty() || unit(walker.random) * walker.hits.size() < walker.proposal.size()))
+        {
+            walker.real = real;
+            walker.imag = imag;
+            walker.hits.swap(walker.proposal);
+        }
+
+        // a rejected move counts the current orbit once more; either way the sample adds up to one hit in total
+        if (!walker.hits.empty())
+        {
+            const float weight = 1.0f / walker.hits.size();
+            for (int pixel : walker.hits)
+                walker.histogram[static_cast<size_t>(pixel)] += weight;
+        }
+    }
+}
+
+template<typename F>
+bool Buddhabrot::trace(double real, double imag, std::vector<int> &hits, qint64 &iterations) const
+{
+    hits.clear();
+    // the Mandelbrot set's cardioid and bulb make up most of its area, and none of it escapes
+    if (!m_settings.anti && m_settings.formula == Formula::Mandelbrot && isInMainCardioidOrBulb(real, imag))
+        return false;
+
+    // the same starting z and constant as the formula's calculatePoint()
+    const bool julia = m_settings.formula == Formula::Julia;
+    const double kReal = julia ? m_juliaReal : real;
+    const double kImag = julia ? m_juliaImag : imag;
+    F::start(real, imag);
+    if (real * real + imag * imag > 4)
+        return !m_settings.anti;
+
+    // the starting point is just where the sample got picked, so only the points the orbit goes on to count
+    PeriodicityCheck<double> periodicity{real, imag, periodTolerance};
+    for (int i = 0; i < m_settings.maxIterations; ++i)
+    {
+        F::step(real, imag, kReal, kImag);
+        if (real * real + imag * imag > 4)
+        {
+            iterations += i + 1;
+            return !m_settings.anti;
+        }
+
+        // pixel (i, j) is at its integer coordinates, so it takes everything up to half a pixel either side of them
+        const double x = (real - m_originReal) * m_scaleX + 0.5;
+        const double y = (imag - m_originImag) * m_scaleY + 0.5;
+        if (x >= 0 && y >= 0 && x < m_size.width() && y < m_size.height())
+            hits.push_back(static_cast<int>(y) * m_size.width() + static_cast<int>(x));
+
+        // a cycle never escapes, which is all the Buddhabrot needs to know; the Anti-Buddhabrot wants every point of it
+        if (!m_settings.anti && periodicity.isPeriodic(real, imag))
+        {
+            iterations += i + 1;
+            return false;
+        }
+    }
+    iterations += m_settings.maxIterations;
+    return m_settings.anti;
+}
+
+void Buddhabrot::randomPoint(Walker &walker, double &real, double &imag) const
+{
+    std::uniform_real_distribution<double> unit;
+    real = m_region.left() + m_region.width() * unit(walker.random);
+    imag = m_region.top() + m_region.height() * unit(walker.random);
+}
+
+bool Buddhabrot::inRegion(double real, double imag) const
+{
+    return m_region.contains(QPointF{real, imag});
+}
@@ -0,0 +1,106 @@
+#ifndef BUDDHABROT_H
+#define BUDDHABROT_H
+
+#include <QRectF>
+#include <QSize>
+
+#include <atomic>
+#include <random>
+#include <vector>
+
+#include "Common.h"
+#include "FractalRect.h"
+#include "Kernels.h"
+#include "RenderTelemetry.h"
+
+// Draws a formula as the density of its orbits rather than by escape time: random starting points get iterated, and
+// every point that the orbit of an escaping one (for the Buddhabrot) or of one that never escapes (the Anti-Buddhabrot)
+// passes through adds a hit to the pixel it lands in. The picture only comes together from millions of orbits, so they
+// get taken in batches, and the histogram can be tone mapped after every one of them.
+//
+// Every thread has a walker with a histogram of its own, so they never contend for a pixel; a batch ends with adding
+// them all up. Zoomed in, hardly any uniformly picked orbit comes near the view, so the walkers switch to
+// Metropolis-Hastings sampling: each one wanders around starting points whose orbits hit the view, by small mutations
+// (and the odd fresh point), accepting a move with odds of how many points of the new orbit land in the view over how
+// many of the current one's do. Every orbit's hits then get weighed by one over that count, which takes out the bias of
+// picking the orbits that way, so the density comes out the same as with uniform samples.
+//
+// The orbits are iterated in double; a view that would need more precision than that (see
+// FractalRect::requiredPrecision()) shows the density at double's resolution.
+class Buddhabrot
+{
+public:
+    struct Settings
+    {
+        Formula formula{Formula::Mandelbrot};
+        complex juliaConstant;
+        int maxIterations{defaultMaxIterations};
+        // count the orbits that never escape instead of the ones that do
+        bool anti{false};
+        int threads{1};
+    };
+
+    // whether formula's orbits escape, which leaves out Newton's fractal
+    static bool supports(Formula formula);
+
+    // view's visual rect sets the size of the histogram, one bin per pixel
+    Buddhabrot(const FractalRect &view, const Settings &settings);
+
+    // iterates samples more orbits, spread over the threads, and adds their hits to the histogram; returns false if
+    // cancelled got set before they were done, in which case the histogram has whatever they got to
+    bool sample(qint64 samples, const std::atomic<bool> *cancelled = nullptr, RenderTelemetry *telemetry = nullptr);
+
+    qint64 samples() const { return m_samples; }
+    qint64 iterations() const { return m_iterations; }
+    bool importanceSampling() const { return m_importance; }
+
+    // the histogram tone mapped into one value per pixel, which the palettes color from dark to bright the way they do
+    // iteration counts; pixels without a single hit are 0, the interior color
+    void toneMap(float *values) const;
+
+private:
+    struct Walker
+    {
+        std::vector<float> histogram;
+        std::mt19937_64 random;
+        // the state of the Markov chain: the starting point, and the pixels its orbit hits; empty until the walker found
+        // an orbit that lands in the view
+        double real{0};
+        double imag{0};
+        std::vector<int> hits;
+        std::vector<int> proposal;
+        qint64 samples{0};
+        qint64 iterations{0};
+    };
+
+    template<typename F>
+    void walk(Walker &walker, qint64 samples, const std::atomic<bool> *cancelled) const;
+    // iterates the orbit of the starting point (real, imag) and collects the pixels it hits into hits; returns whether
+    // the orbit counts, i.e. escaped (or, for the Anti-Buddhabrot, didn't)
+    template<typename F>
+    bool trace(double real, double imag, std::vector<int> &hits, qint64 &iterations) const;
+    // a starting point anywhere in the region the samples come from
+    void randomPoint(Walker &walker, double &real, double &imag) const;
+    bool inRegion(double real, double imag) const;
+
+    Settings m_settings;
+    QSize m_size;
+    // where pixel (0, 0) is, and how many pixels to a unit along each axis
+    double m_originReal;
+    double m_originImag;
+    double m_scaleX;
+    double m_scaleY;
+    double m_viewWidth;
+    double m_juliaReal;
+    double m_juliaImag;
+    // the formula's initial view, which has all of the points whose orbits don't escape right away
+    QRectF m_region;
+    bool m_importance;
+
+    std::vector<Walker> m_walkers;
+    std::vector<double> m_histogram;
+    qint64 m_samples{0};
+    qint64 m_iterations{0};
+};
+
+#endif // BUDDHABROT_H
@@ -1,10 +1,151 @@
 #ifndef COMMON_H
 #define COMMON_H
 
+#include <QByteArray>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
 #include <complex>
+#include <ios>
+#include <string>
+#include <type_traits>
 #include <boost/multiprecision/mpfr.hpp>
 
 using big_float = boost::multiprecision::mpfr_float;
 using complex = std::complex<big_float>;
 
+// value written out with every digit it has, so that parsing it back at the same precision gives exactly the same
+// number, and equal strings mean equal values
+inline QByteArray exactString(const big_float &value)
+{
+    return QByteArray::fromStdString(value.str(0, std::ios_base::scientific));
+}
+
+// text (a decimal number, as typed in) parsed with enough digits to keep every one it has, and never fewer than long
+// double would; throws std::runtime_error if it isn't a number
+inline big_float parseDecimal(const std::string &text)
+{
+    return big_float{text, static_cast<unsigned>(std::max<std::size_t>(text.size(), 20) + 10)};
+}
+
+#if defined(__SIZEOF_FLOAT128__) && !defined(__clang__)
+#define FRACTURE_HAS_FLOAT128
+#endif
+
+// the fractals the kernels know how to calculate; see Formulas.h for what each of them is
+enum class Formula
+{
+    Mandelbrot,
+    Julia,
+    BurningShip,
+    Multibrot3,
+    Multibrot4,
+    Tricorn,
+    Newton,
+};
+
+// what a formula's picture looks the same under
+enum class Symmetry
+{
+    None,
+    // mirroring about the real axis: conjugating a point conjugates its whole orbit
+    Conjugate,
+    // half a turn about the origin: negating a point negates its orbit, or squares it away on the first step
+    Origin,
+};
+
+// the scalar types a render can run in, from cheapest to most precise
+enum class Precision
+{
+    Double,
+    LongDouble,
+    Float128,
+    MultiPrecision,
+};
+
+inline const char *precisionName(Precision precision)
+{
+    switch (precision)
+    {
+    case Precision::Double:
+        return "double";
+    case Precision::LongDouble:
+        return "long double";
+    case Precision::Float128:
+        return "__float128";
+    default:
+        return "MPFR";
+    }
+}
+
+// roughly how many times as long an iteration in precision takes as one in double, for showing what a zoom level
+// costs; digits only matters for MPFR. Measured on the Mandelbrot kernel: MPFR has a large fixed cost per operation,
+// and past a few limbs the multiplications take over, which grow with the square of the limb count at these sizes.
+inline double precisionCost(Precision precision, unsigned digits)
+{
+    switch (precision)
+    {
+    case Precision::Double:
+        return 1;
+    case Precision::LongDouble:
+        return 1.5;
+    case Precision::Float128:
+        return 70;
+    default:
+    {
+        const double limbs = std::ceil(digits / 19.3);
+        return 100 + 12 * limbs + 0.6 * limbs * limbs;
+    }
+    }
+}
+
+template<typename F, typename = void>
+struct HasThreadDefaultPrecision : std::false_type
+{};
+template<typename F>
+struct HasThreadDefaultPrecision<F, std::void_t<decltype(F::thread_default_precision())>> : std::true_type
+{};
+
+// Sets the precision (in decimal digits) that new MPFR values get on the calling thread for as long as it lives. Values
+// worked out from other big_floats take on the precision of those anyway, so this only matters for the ones that start
+// out from a plain number or a string.
+//
+// Newer versions of Boost keep the default per thread, so every render thread can work at the precision of its own
+// job. Older ones only have the one default for the whole process, which threads setting and putting back out of order
+// would pull out from under each other, so there the guard does nothing. Code that needs a value from a plain number to
+// have the view's digits therefore has to give it them explicitly (like ReferenceOrbit's first z) rather than count on
+// the guard.
+class PrecisionGuard
+{
+public:
+    explicit PrecisionGuard(unsigned digits)
+        : m_previous{exchange(digits)}
+    {}
+    ~PrecisionGuard()
+    {
+        if (m_previous)
+            exchange(m_previous);
+    }
+
+    PrecisionGuard(const PrecisionGuard &) = delete;
+    PrecisionGuard &operator=(const PrecisionGuard &) = delete;
+
+private:
+    // sets the thread's default and returns the one to go back to, or 0 if there's no default per thread
+    template<typename F = big_float>
+    static unsigned exchange(unsigned digits)
+    {
+        if constexpr (HasThreadDefaultPrecision<F>::value)
+        {
+            const unsigned previous = F::thread_default_precision();
+            F::thread_default_precision(digits);
+            return previous;
+        }
+        return 0;
+    }
+
+    unsigned m_previous;
+};
+
 #endif // COMMON_H
@@ -0,0 +1,439 @@
+#ifndef FORMULAS_H
+#define FORMULAS_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+#include "Common.h"
+#include "Kernels.h"
+
+// The fractals fracture can draw. Every one of them is a type with a static calculatePoint() templated on the scalar
+// type; the escape-time ones only supply a templated step for iterateEscapeTime() in Kernels.h. The renderers pick the
+// type with visitFormula() once per tile and run the whole tile loop instantiated for it, so there's no dispatch left
+// per pixel and the compiler gets to inline (and for the Multibrot sets unroll) the step.
+//
+// Adding a fractal takes a Formula value, a type for it here and an entry in RegisteredFormulas at the bottom; the
+// viewer, fracture-render and fracture-bench all enumerate that list.
+
+// what the kernels need to know besides the point itself
+template<typename T>
+struct KernelParameters
+{
+    // only the Julia set looks at these
+    T juliaReal;
+    T juliaImag;
+    int maxIterations;
+    // see PeriodicityCheck
+    T periodTolerance;
+};
+
+// everything about a formula that isn't the math
+struct FormulaInfo
+{
+    struct Bounds
+    {
+        double left;
+        double top;
+        double width;
+        double height;
+    };
+
+    Formula id;
+    // what fracture-render and fracture-bench call it
+    const char *name;
+    // what the viewer calls it
+    const char *label;
+    // the part of the plane it starts out showing
+    Bounds initialView;
+    // calculatePoints() has vector kernels for it; the other formulas get their scalar kernel in double as well
+    bool vectorized;
+    // deep zooms can track it with Perturbation; the other formulas stay on the direct kernels, in MPFR if need be
+    bool perturbation;
+    // lets a view that straddles the axis (or origin) calculate one side of it and mirror the other, see Mirror
+    Symmetry symmetry;
+};
+
+// z = z^2 + k, which the Mandelbrot and Julia sets share and the Burning Ship and the Tricorn build on
+struct QuadraticStep
+{
+    // the power z gets raised to, for smoothIterations()
+    static constexpr int degree = 2;
+
+    // gets a say in the z the iteration starts out with
+    template<typename T>
+    static void start(T &, T &)
+    {}
+
+    template<typename T>
+    static void step(T &real, T &imag, const T &kReal, const T &kImag)
+    {
+        const T temp = real * real - imag * imag + kReal;
+        imag = 2 * real * imag + kImag;
+        real = temp;
+    }
+
+    static void step(MultiPrecisionScratch &scratch, const big_float &kReal, const big_float &kImag)
+    {
+        // z^2 = real^2 - imag^2 + 2 * real * imag * i, and the squares are left over from the magnitude
+        boost::multiprecision::multiply(scratch.imag, scratch.imag, scratch.real);
+        scratch.imag *= 2;
+        scratch.imag += kImag;
+        boost::multiprecision::subtract(scratch.real, scratch.real2, scratch.imag2);
+        scratch.real += kReal;
+    }
+};
+
+struct MandelbrotFormula : QuadraticStep
+{
+    static constexpr FormulaInfo info{Formula::Mandelbrot, "mandelbrot", "Mandelbrot", {-2.5, -2, 4, 4}, true, true, Symmetry::Conjugate};
+
+    template<typename T>
+    static float calculatePoint(const T &cReal, const T &cImag, const KernelParameters<T> &parameters,
+                                const std::atomic<bool> *cancelled = nullptr)
+    {
+        if (isInMainCardioidOrBulb(cReal, cImag))
+            return 0;
+
+        // z starts out at c, so from here on this is a Julia iteration with k = c
+        return iterateEscapeTime<MandelbrotFormula>(cReal, cImag, cReal, cImag, parameters.maxIterations, parameters.periodTolerance,
+                                                    cancelled);
+    }
+};
+
+struct JuliaFormula : QuadraticStep
+{
+    static constexpr FormulaInfo info{Formula::Julia, "julia", "Julia", {-2, -2, 4, 4}, true, true, Symmetry::Origin};
+
+    template<typename T>
+    static float calculatePoint(const T &real, const T &imag, const KernelParameters<T> &parameters,
+                                const std::atomic<bool> *cancelled = nullptr)
+    {
+        return iterateEscapeTime<JuliaFormula>(real, imag, parameters.juliaReal, parameters.juliaImag, parameters.maxIterations,
+                                               parameters.periodTolerance, cancelled);
+    }
+};
+
+// <https://en.wikipedia.org/wiki/Burning_Ship_fractal> was instrumental in creating this one: z gets folded into the
+// first quadrant before every squaring, which is the same as folding the starting z and every step's result. The folding
+// leaves it without any of the Mandelbrot set's symmetry.
+struct BurningShipFormula : QuadraticStep
+{
+    static constexpr FormulaInfo info{Formula::BurningShip, "burningship", "Burning ship", {-2.5, -2, 4, 4}, true, true, Symmetry::None};
+
+    template<typename T>
+    static void start(T &real, T &imag)
+    {
+        makeNonNegative(real);
+        makeNonNegative(imag);
+    }
+
+    template<typename T>
+    static void step(T &real, T &imag, const T &cReal, const T &cImag)
+    {
+        QuadraticStep::step(real, imag, cReal, cImag);
+        makeNonNegative(real);
+        makeNonNegative(imag);
+    }
+
+    static void step(MultiPrecisionScratch &scratch, const big_float &cReal, const big_float &cImag)
+    {
+        QuadraticStep::step(scratch, cReal, cImag);
+        makeNonNegative(scratch.real);
+        makeNonNegative(scratch.imag);
+    }
+
+    template<typename T>
+    static float calculatePoint(const T &cReal, const T &cImag, const KernelParameters<T> &parameters,
+                                const std::atomic<bool> *cancelled = nullptr)
+    {
+        return iterateEscapeTime<BurningShipFormula>(cReal, cImag, cReal, cImag, parameters.maxIterations, parameters.periodTolerance,
+                                                     cancelled);
+    }
+};
+
+// z = z^Power + c; the loop in step() always runs Power - 1 times, so it gets unrolled into plain complex multiplications
+template<int Power>
+struct MultibrotKernel
+{
+    static_assert(Power >= 2, "the Multibrot sets start at z^2");
+
+    static constexpr int degree = Power;
+
+    template<typename T>
+    static void start(T &, T &)
+    {}
+
+    template<typename T>
+    static void step(T &real, T &imag, const T &cReal, const T &cImag)
+    {
+        T powerReal = real;
+        T powerImag = imag;
+        for (int n = 1; n < Power; ++n)
+        {
+            const T temp = powerReal * real - powerImag * imag;
+            powerImag = powerReal * imag + powerImag * real;
+            powerReal = temp;
+        }
+        real = powerReal + cReal;
+        imag = powerImag + cImag;
+    }
+
+    static void step(MultiPrecisionScratch &scratch, const big_float &cReal, const big_float &cImag)
+    {
+        using boost::multiprecision::add;
+        using boost::multiprecision::multiply;
+
+        scratch.termReal = scratch.real;
+        scratch.termImag = scratch.imag;
+        for (int n = 1; n < Power; ++n)
+        {
+            multiply(scratch.temp, scratch.termReal, scratch.real);
+            multiply(scratch.distance, scratch.termImag, scratch.imag);
+            scratch.temp -= scratch.distance;
+            multiply(scratch.distance, scratch.termReal, scratch.imag);
+            scratch.termImag *= scratch.real;
+            scratch.termImag += scratch.distance;
+            scratch.termReal.swap(scratch.temp);
+        }
+        add(scratch.real, scratch.termReal, cReal);
+        add(scratch.imag, scratch.termImag, cImag);
+    }
+
+    template<typename T>
+    static float calculatePoint(const T &cReal, const T &cImag, const KernelParameters<T> &parameters,
+                                const std::atomic<bool> *cancelled = nullptr)
+    {
+        return iterateEscapeTime<MultibrotKernel>(cReal, cImag, cReal, cImag, parameters.maxIterations, parameters.periodTolerance,
+                                                  cancelled);
+    }
+};
+
+struct Multibrot3Formula : MultibrotKernel<3>
+{
+    static constexpr FormulaInfo info{Formula::Multibrot3, "multibrot3", "Multibrot z³", {-2, -2, 4, 4}, false, false, Symmetry::Conjugate};
+};
+
+struct Multibrot4Formula : MultibrotKernel<4>
+{
+    static constexpr FormulaInfo info{Formula::Multibrot4, "multibrot4", "Multibrot z⁴", {-2, -2, 4, 4}, false, false, Symmetry::Conjugate};
+};
+
+// the Mandelbrot set with z conjugated before every squaring, z = conj(z)^2 + c
+struct TricornFormula : QuadraticStep
+{
+    static constexpr FormulaInfo info{Formula::Tricorn, "tricorn", "Tricorn", {-2, -2, 4, 4}, false, false, Symmetry::Conjugate};
+
+    template<typename T>
+    static void step(T &real, T &imag, const T &cReal, const T &cImag)
+    {
+        const T temp = real * real - imag * imag + cReal;
+        imag = -2 * real * imag + cImag;
+        real = temp;
+    }
+
+    static void step(MultiPrecisionScratch &scratch, const big_float &cReal, const big_float &cImag)
+    {
+        boost::multiprecision::multiply(scratch.imag, scratch.imag, scratch.real);
+        scratch.imag *= -2;
+        scratch.imag += cImag;
+        boost::multiprecision::subtract(scratch.real, scratch.real2, scratch.imag2);
+        scratch.real += cReal;
+    }
+
+    template<typename T>
+    static float calculatePoint(const T &cReal, const T &cImag, const KernelParameters<T> &parameters,
+                                const std::atomic<bool> *cancelled = nullptr)
+    {
+        return iterateEscapeTime<TricornFormula>(cReal, cImag, cReal, cImag, parameters.maxIterations, parameters.periodTolerance,
+                                                 cancelled);
+    }
+};
+
+// Newton's method for z^3 = 1, see <https://en.wikipedia.org/wiki/Newton_fractal>: every point is a first guess that
+// gets refined by z = z - (z^3 - 1) / (3 z^2) = (2 z^3 + 1) / (3 z^2) until it settles on one of the cube roots of
+// unity. Nothing escapes here, so the count is how many steps that took instead. Points that never settle (the origin,
+// which has no next step, and the odd one right on the border between two roots) come out as interior points.
+struct NewtonFormula
+{
+    static constexpr FormulaInfo info{Formula::Newton, "newton", "Newton", {-2, -2, 4, 4}, false, false, Symmetry::Conjugate};
+
+    // how close (squared) two guesses in a row have to be for the point to count as settled; about 1e-12, and a power of
+    // two so that the MPFR kernel can scale by it exactly
+    static constexpr int toleranceBits = 40;
+    static constexpr double tolerance = 1.0 / (1ll << toleranceBits);
+
+    // one step of the method; returns false at the origin, where it's undefined
+    template<typename T>
+    static bool step(T &real, T &imag)
+    {
+        const T real2 = real * real - imag * imag;
+        const T imag2 = 2 * real * imag;
+        // dividing by 3 z^2 is multiplying by its conjugate and dividing by its squared magnitude
+        const T norm = 3 * (real2 * real2 + imag2 * imag2);
+        if (norm == 0)
+            return false;
+
+        const T numeratorReal = 2 * (real2 * real - imag2 * imag) + 1;
+        const T numeratorImag = 2 * (real2 * imag + imag2 * real);
+        real = (numeratorReal * real2 + numeratorImag * imag2) / norm;
+        imag = (numeratorImag * real2 - numeratorReal * imag2) / norm;
+        return true;
+    }
+
+    template<typename T>
+    static float calculatePoint(const T &real, const T &imag, const KernelParameters<T> &parameters,
+                                const std::atomic<bool> *cancelled = nullptr)
+    {
+        T zReal = real;
+        T zImag = imag;
+        for (int i = 0; i < parameters.maxIterations; ++i)
+        {
+            if (isCancelled(cancelled, i))
+                return 0;
+
+            const T previousReal = zReal;
+            const T previousImag = zImag;
+            if (!step(zReal, zImag))
+                return 0;
+
+            const T stepReal = zReal - previousReal;
+            const T stepImag = zImag - previousImag;
+            const T distance = stepReal * stepReal + stepImag * stepImag;
+            if (distance < tolerance)
+                return settledIterations(i + 1, static_cast<double>(distance));
+        }
+        return 0;
+    }
+
+    // step() and calculatePoint() in scratch: real2 and imag2 hold z^2, magnitude the norm and term the numerator
+    static float calculatePoint(const big_float &real, const big_float &imag, const KernelParameters<big_float> &parameters,
+                                const std::atomic<bool> *cancelled = nullptr)
+    {
+        using boost::multiprecision::multiply;
+
+        auto &scratch = MultiPrecisionScratch::local(real.precision());
+        scratch.real = real;
+        scratch.imag = imag;
+        for (int i = 0; i < parameters.maxIterations; ++i)
+        {
+            if (isCancelled(cancelled, i))
+                return 0;
+
+            multiply(scratch.real2, scratch.real, scratch.real);
+            multiply(scratch.temp, scratch.imag, scratch.imag);
+            scratch.real2 -= scratch.temp;
+            multiply(scratch.imag2, scratch.real, scratch.imag);
+            scratch.imag2 *= 2;
+            multiply(scratch.magnitude, scratch.real2, scratch.real2);
+            multiply(scratch.temp, scratch.imag2, scratch.imag2);
+            scratch.magnitude += scratch.temp;
+            scratch.magnitude *= 3;
+            if (scratch.magnitude == 0)
+                return 0;
+
+            multiply(scratch.termReal, scratch.real2, scratch.real);
+            multiply(scratch.temp, scratch.imag2, scratch.imag);
+            scratch.termReal -= scratch.temp;
+            scratch.termReal *= 2;
+            scratch.termReal += 1;
+            multiply(scratch.termImag, scratch.real2, scratch.imag);
+            multiply(scratch.temp, scratch.imag2, scratch.real);
+            scratch.termImag += scratch.temp;
+            scratch.termImag *= 2;
+
+            // the next z goes into temp and distance, since working it out still needs the current one
+            multiply(scratch.temp, scratch.termReal, scratch.real2);
+            multiply(scratch.distance, scratch.termImag, scratch.imag2);
+            scratch.temp += scratch.distance;
+            scratch.temp /= scratch.magnitude;
+            multiply(scratch.distance, scratch.termImag, scratch.real2);
+            multiply(scratch.termImag, scratch.termReal, scratch.imag2);
+            scratch.distance -= scratch.termImag;
+            scratch.distance /= scratch.magnitude;
+
+            // real and imag become the step (the wrong way round, which doesn't matter once it's squared) and swap places
+            // with the next z
+            scratch.real -= scratch.temp;
+            scratch.imag -= scratch.distance;
+            scratch.real.swap(scratch.temp);
+            scratch.imag.swap(scratch.distance);
+            multiply(scratch.magnitude, scratch.temp, scratch.temp);
+            multiply(scratch.real2, scratch.distance, scratch.distance);
+            scratch.magnitude += scratch.real2;
+            // comparing against a double would take a temporary, so this compares the step over the tolerance against 1
+            scratch.magnitude *= 1 << (toleranceBits / 2);
+            scratch.magnitude *= 1 << (toleranceBits / 2);
+            if (scratch.magnitude < 1)
+                return settledIterations(i + 1, scratch.magnitude.convert_to<double>() * tolerance);
+        }
+        return 0;
+    }
+
+    // The smoothed count of a point that settled after iterations steps, the last one distance (squared) long. Close to
+    // a root every step is about the square of the one before, so the fraction goes from 1 for a last step that only
+    // just got under the tolerance down to 0 for one of about the tolerance squared, like smoothIterations() does for
+    // escaping orbits.
+    static float settledIterations(int iterations, double distance)
+    {
+        const float fraction = 1 - static_cast<float>(std::log2(std::log(distance) / std::log(tolerance)));
+        const float ceiling = std::nextafter(static_cast<float>(iterations + 1), 0.0f);
+        return std::min(iterations + std::max(fraction, 0.0f), ceiling);
+    }
+};
+
+template<typename... Formulas>
+struct FormulaList
+{
+    static constexpr std::array<FormulaInfo, sizeof...(Formulas)> infos{Formulas::info...};
+};
+
+// every formula there is, in the order of the Formula enum
+using RegisteredFormulas = FormulaList<MandelbrotFormula, JuliaFormula, BurningShipFormula, Multibrot3Formula, Multibrot4Formula,
+                                       TricornFormula, NewtonFormula>;
+
+static_assert(
+    [] {
+        for (std::size_t i = 0; i < RegisteredFormulas::infos.size(); ++i)
+            if (static_cast<std::size_t>(RegisteredFormulas::infos[i].id) != i)
+                return false;
+        return true;
+    }(),
+    "RegisteredFormulas has to list the formulas in the order of the Formula enum");
+
+inline const auto &formulas()
+{
+    return RegisteredFormulas::infos;
+}
+
+inline const FormulaInfo &formulaInfo(Formula formula)
+{
+    return formulas()[static_cast<std::size_t>(formula)];
+}
+
+// the formula called name, or null if there is none
+inline const FormulaInfo *findFormula(const char *name)
+{
+    for (const auto &info : formulas())
+        if (std::strcmp(info.name, name) == 0)
+            return &info;
+    return nullptr;
+}
+
+template<typename Visitor, typename... Formulas>
+void visitFormula(Formula formula, FormulaList<Formulas...>, Visitor &visitor)
+{
+    ((formula == Formulas::info.id ? (visitor(Formulas{}), true) : false) || ...);
+}
+
+// calls visitor with a (stateless) value of formula's type, so it can instantiate whatever it does for that formula
+template<typename Visitor>
+void visitFormula(Formula formula, Visitor &&visitor)
+{
+    visitFormula(formula, RegisteredFormulas{}, visitor);
+}
+
+#endif // FORMULAS_H
@@ -1,6 +1,27 @@
 #include "FractalRect.h"
 
-#include <QVector>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// how many bits of headroom we want below the pixel spacing before we trust a scalar type with a view
+constexpr int precisionGuardBits = 12;
+// MPFR gets a lot more: the digits a view is stored with have to carry it through the next few zooms and pans until
+// it gets to raise them, and the orbits of the pixels lose a few bits on the way
+constexpr int multiPrecisionGuardBits = 32;
+// the fewest digits a view gets, however shallow it is
+constexpr unsigned minimumDigits = 20;
+
+namespace
+{
+// value with at least digits of precision
+big_float withPrecision(big_float value, unsigned digits)
+{
+    if (value.precision() < digits)
+        value.precision(digits);
+    return value;
+}
+}
 
 FractalRect::FractalRect()
 {}
@@ -22,6 +43,20 @@ FractalRect::FractalRect(big_float x, big_float y, big_float width, big_float he
     setVisualRect(visualRect);
 }
 
+FractalRect FractalRect::centered(const complex &center, const big_float &width, const QRectF &visualRect)
+{
+    const big_float height = width * visualRect.height() / visualRect.width();
+    big_float magnitude = boost::multiprecision::abs(center.real());
+    if (boost::multiprecision::abs(center.imag()) > magnitude)
+        magnitude = boost::multiprecision::abs(center.imag());
+    magnitude += width;
+    if (magnitude < 2)
+        magnitude = 2;
+    const unsigned digits = requiredDigits(magnitude, big_float{width / visualRect.width()});
+    return FractalRect{withPrecision(center.real(), digits) - width / 2, withPrecision(center.imag(), digits) - height / 2, width, height,
+                       visualRect};
+}
+
 void FractalRect::setVisualRect(const QRectF &visualRect)
 {
     // first we need to parse what our new dimensions will be for the fractal rect
@@ -47,68 +82,30 @@ void FractalRect::setVisualRect(const QRectF &visualRect)
     }
 
     m_visualRect = visualRect;
+    // a bigger visual rect means smaller pixels
+    growPrecision();
 }
 
-QVector<FractalRect> FractalRect::split(int parts)
+void FractalRect::translate(int dx, int dy)
 {
-    if (parts == 1)
-        return {*this};
-
-    QVector<double> factors; // double to ensure double division later on
-    // we'll limit the amount of factors that can be factored out to prevent the application from hanging while trying to factor
-    // a massive prime (997 is the last prime before 1000; I was going to put 1000 but it seemed odd to end on a non-prime number)
-    for (int i = 2; parts > 1 && i <= 997; ++i)
-    {
-        while (parts % i == 0)
-        {
-            factors.push_back(i);
-            parts /= i;
-        }
-    }
-
-    QVector<FractalRect> rects{*this};
-
-    for (const auto &factor : factors)
-    {
-        for (int i = 0; i < rects.length(); i += factor)
-        {
-            auto rect = rects[i];
-            rects.removeAt(i);
-            const auto &vr = rect.m_visualRect;
-
-            // compare visual rect specs because it's probably faster than using a multiprecision number
-            if (vr.width() > vr.height())
-            {
-                for (int j = 0; j < factor; ++j)
-                    rects.insert(i + j,
-                                 FractalRect{rect.m_x + rect.m_width / factor * j,
-                                             rect.m_y,
-                                             rect.m_width / factor,
-                                             rect.m_height,
-                                             QRectF{vr.x() + vr.width() / factor * j,
-                                                    vr.y(),
-                                                    vr.width() / factor,
-                                                    vr.height()}
-                                 });
-            }
-            else
-            {
-                for (int j = 0; j < factor; ++j)
-                    rects.insert(i + j,
-                                 FractalRect{rect.m_x,
-                                             rect.m_y + rect.m_height / factor * j,
-                                             rect.m_width,
-                                             rect.m_height / factor,
-                                             QRectF{vr.x(),
-                                                    vr.y() + vr.height() / factor * j,
-                                                    vr.width(),
-                                                    vr.height() / factor}
-                                 });
-            }
-        }
-    }
+    const big_float realShift = m_width / m_visualRect.width() * dx;
+    const big_float imagShift = m_height / m_visualRect.height() * dy;
+    m_x += realShift;
+    m_coreX += realShift;
+    m_y += imagShift;
+    m_coreY += imagShift;
+}
 
-    return rects;
+FractalRect FractalRect::zoomed(const big_float &factor, const QPointF &offset) const
+{
+    const big_float width = m_coreWidth * factor;
+    const big_float height = m_coreHeight * factor;
+    const big_float spacing = m_width / m_visualRect.width();
+    // zooming in can take more digits than the rect has, and the corner has to be worked out with all of them, or it
+    // would end up on the coarser grid of the old pixels
+    const unsigned digits = requiredDigits(magnitude(), big_float{spacing * factor});
+    return FractalRect{withPrecision(m_coreX, digits) + (m_coreWidth - width) / 2 + spacing * offset.x(),
+                       withPrecision(m_coreY, digits) + (m_coreHeight - height) / 2 + spacing * offset.y(), width, height, m_visualRect};
 }
 
 complex FractalRect::getFractalValueFromVisualPoint(const double &x, const double &y) const
@@ -126,3 +123,79 @@ complex FractalRect::getFractalValueFromVisualPoint(const QPointF &point) const
 
     return complex{realPoint, imagPoint};
 }
+
+Precision FractalRect::requiredPrecision() const
+{
+    if (m_visualRect.isEmpty())
+        return Precision::Double;
+
+    // the spacing between pixels has to stay well above the rounding error of the largest value we'll be working with,
+    // otherwise neighbouring pixels collapse onto the same value and the image turns blocky
+    const big_float spacing = m_width / m_visualRect.width();
+    const double ratio = big_float{spacing / magnitude()}.convert_to<double>();
+    auto fits = [ratio](int digits) {
+        return ratio > std::ldexp(1.0, precisionGuardBits - digits);
+    };
+
+    if (fits(std::numeric_limits<double>::digits))
+        return Precision::Double;
+    if (std::numeric_limits<long double>::digits > std::numeric_limits<double>::digits &&
+            fits(std::numeric_limits<long double>::digits))
+        return Precision::LongDouble;
+#ifdef FRACTURE_HAS_FLOAT128
+    // IEEE quad precision has a 113 bit significand
+    if (fits(113))
+        return Precision::Float128;
+#endif
+    return Precision::MultiPrecision;
+}
+
+unsigned FractalRect::requiredDigits() const
+{
+    if (m_visualRect.isEmpty())
+        return minimumDigits;
+
+    return requiredDigits(magnitude(), big_float{m_width / m_visualRect.width()});
+}
+
+unsigned FractalRect::requiredDigits(const big_float &magnitude, const big_float &spacing)
+{
+    if (spacing <= 0)
+        return minimumDigits;
+
+    // the same rule as requiredPrecision(), only with the bits counted out instead of checked against a type
+    const double bits = boost::multiprecision::log(big_float{magnitude / spacing}).convert_to<double>() / std::log(2.0) + multiPrecisionGuardBits;
+    return std::max(minimumDigits, static_cast<unsigned>(std::ceil(bits * std::log10(2.0))));
+}
+
+unsigned FractalRect::precision() const
+{
+    unsigned digits = m_x.precision();
+    for (const big_float *value : {&m_y, &m_width, &m_height, &m_coreX, &m_coreY, &m_coreWidth, &m_coreHeight})
+        digits = std::min(digits, value->precision());
+    return digits;
+}
+
+void FractalRect::setPrecision(unsigned digits)
+{
+    for (big_float *value : {&m_x, &m_y, &m_width, &m_height, &m_coreX, &m_coreY, &m_coreWidth, &m_coreHeight})
+        value->precision(digits);
+}
+
+big_float FractalRect::magnitude() const
+{
+    // orbits can grow to a magnitude of 2 before they escape, so that's the floor
+    big_float magnitude = 2;
+    for (const big_float &edge : {big_float{m_x}, big_float{m_x + m_width}, big_float{m_y}, big_float{m_y + m_height}})
+        if (boost::multiprecision::abs(edge) > magnitude)
+            magnitude = boost::multiprecision::abs(edge);
+    return magnitude;
+}
+
+void FractalRect::growPrecision()
+{
+    const unsigned digits = requiredDigits();
+    for (big_float *value : {&m_x, &m_y, &m_width, &m_height, &m_coreX, &m_coreY, &m_coreWidth, &m_coreHeight})
+        if (value->precision() < digits)
+            value->precision(digits);
+}
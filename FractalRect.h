@@ -11,25 +11,51 @@ public:
     FractalRect();
     FractalRect(big_float x, big_float y, big_float width, big_float height);
     FractalRect(big_float x, big_float y, big_float width, big_float height, QRectF visualRect);
+    // the rect width wide around center, as high as visualRect's aspect ratio makes it; its corner gets worked out with
+    // as many digits as telling the pixels apart takes, however few center and width came with
+    static FractalRect centered(const complex &center, const big_float &width, const QRectF &visualRect);
 
     void setVisualRect(const QRectF &visualRect);
     QRectF visualRect() const { return m_visualRect; }
-    QVector<FractalRect> split(int parts);
+    // moves the rect by a number of pixels of its visual rect
+    void translate(int dx, int dy);
+    // the rect scaled by factor around its middle (so factors below 1 zoom in), then moved by offset pixels of its
+    // visual rect; the visual rect stays the same
+    FractalRect zoomed(const big_float &factor, const QPointF &offset = {}) const;
 
-    big_float x() const { return m_x; }
-    big_float y() const { return m_y; }
-    big_float width() const { return m_width; }
-    big_float height() const { return m_height; }
+    const big_float &x() const { return m_x; }
+    const big_float &y() const { return m_y; }
+    const big_float &width() const { return m_width; }
+    const big_float &height() const { return m_height; }
 
-    big_float coreX() const { return m_coreX; }
-    big_float coreY() const { return m_coreY; }
-    big_float coreWidth() const { return m_coreWidth; }
-    big_float coreHeight() const { return m_coreHeight; }
+    const big_float &coreX() const { return m_coreX; }
+    const big_float &coreY() const { return m_coreY; }
+    const big_float &coreWidth() const { return m_coreWidth; }
+    const big_float &coreHeight() const { return m_coreHeight; }
 
     complex getFractalValueFromVisualPoint(const double &x, const double &y) const;
     complex getFractalValueFromVisualPoint(const QPointF &point) const;
 
+    // the cheapest scalar type that can still tell neighbouring pixels apart
+    Precision requiredPrecision() const;
+    // how many decimal digits MPFR needs for the same, with a good margin; unlike the hardware types this keeps growing
+    // the deeper the view is
+    unsigned requiredDigits() const;
+    // the same for points spacing apart on a view that reaches out to magnitude
+    static unsigned requiredDigits(const big_float &magnitude, const big_float &spacing);
+
+    // the precision (in decimal digits) the coordinates are stored with; the rect raises it by itself whenever a change
+    // makes it need more, so panning and zooming never lose digits
+    unsigned precision() const;
+    // rounds the coordinates to digits, which may also be fewer than they have
+    void setPrecision(unsigned digits);
+
 private:
+    // the largest absolute value of the rect's edges, but at least the escape radius
+    big_float magnitude() const;
+    // raises the precision to requiredDigits() if it's below that
+    void growPrecision();
+
     // these hold the current size of the rect
     big_float m_x;
     big_float m_y;
@@ -1,230 +1,941 @@
 #include "FractalView.h"
 
+#include <QElapsedTimer>
 #include <QTimer>
-#include <QPainter>
+#include <QQuickWindow>
 #include <QRandomGenerator64>
+#include <QSGSimpleTextureNode>
 #include <QtConcurrent>
 #include <QThread>
 
 #include <QSaveFile>
 #include <QStandardPaths>
 
+#include "Formulas.h"
+#include "PixelStepper.h"
+#include "SimdKernels.h"
+#include "Supersampler.h"
+#include "TileScheduler.h"
+
+#include <algorithm>
+#include <cmath>
 #include <complex>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 FractalView::FractalView(QQuickItem *parent)
-    : QQuickPaintedItem{parent},
+    : QQuickItem{parent},
       m_width{width()},
       m_height{height()},
-      m_fractalRects{{Type::Mandelbrot, FractalRect{-2.5, -2, 4, 4}},
-                     {Type::Julia, FractalRect{-2, -2, 4, 4}},
-                     {Type::BurningShip, FractalRect{-2.5, -2, 4, 4}}},
       m_image{boundingRect().size().toSize(), QImage::Format_ARGB32}
 {
-    connect(this, &FractalView::updateView, this, [this] { update(); }, Qt::QueuedConnection);
+    // every formula starts out on its own part of the plane, and keeps its own view from then on
+    for (const auto &formula : ::formulas())
+        m_fractalRects.emplace_back(formula.initialView.left, formula.initialView.top, formula.initialView.width, formula.initialView.height);
+
+    setFlag(ItemHasContents);
+    connect(this, &FractalView::updateView, this, [this] {
+        polish();
+        update();
+    }, Qt::QueuedConnection);
+    // a new size means a new image, which updatePolish() takes care of
+    connect(this, &QQuickItem::widthChanged, this, &QQuickItem::polish);
+    connect(this, &QQuickItem::heightChanged, this, &QQuickItem::polish);
+
+    m_dirtyTiles = std::make_shared<DirtyTiles>(m_image.size());
+    updatePalette();
 }
 
 FractalView::~FractalView()
 {
     cancelRender();
+    // cancelled renders bail out within a few milliseconds, but they still hold on to this object until they do
+    for (auto &render : m_renders)
+        render.waitForFinished();
 }
 
-// the methodology of these two functions come from John R. H. Goering's
-// book `The Powers of the Square Root of -1` and also from
-// <https://warp.povusers.org/Mandelbrot>
-int calculateJuliaPoint(const complex &z, const complex &k)
+// each render goes through these passes, from one pixel in every 4x4 block via one in every 2x2 block to all of them
+constexpr int coarsestBlockSize = 4;
+constexpr int progressivePasses = 3;
+
+// a density render is done once it has iterated this many orbits per pixel; the first batch has a quarter of one per
+// pixel, and every batch after that as many as all the ones before it
+constexpr int densitySamplesPerPixel = 64;
+
+// the image goes on screen in tiles of this size; every render tile falls into exactly one of them. Smaller ones would
+// upload less of the image per frame while it renders, but every one is a texture of its own, and so a draw call.
+constexpr int textureTileSize = 4 * TileScheduler::tileSize;
+
+namespace
 {
-    if (std::abs(z) > 2)
-        return 1;
-    else
+// one tile of the image on screen; it owns its texture, which gets replaced whenever the tile's pixels change
+class TileNode : public QSGSimpleTextureNode
+{
+public:
+    ~TileNode() override { delete texture(); }
+
+    void replaceTexture(QSGTexture *texture)
     {
-        auto zSquaredPlusK = z;
-        for (int i = 0; i < 25; ++i)
-        {
-            zSquaredPlusK = (zSquaredPlusK * zSquaredPlusK) + k;
-            if (boost::multiprecision::pow(zSquaredPlusK.real(), 2) + boost::multiprecision::pow(zSquaredPlusK.imag(), 2) > 4)
-                return i + 1;
-        }
-        return 0;
+        QSGTexture *old = this->texture();
+        setTexture(texture);
+        delete old;
     }
+};
 }
 
-int calculateMandelbrotPoint(const complex &c)
+FractalView::DirtyTiles::DirtyTiles(QSize imageSize)
+    : imageSize{imageSize},
+      columns{(std::max(imageSize.width(), 0) + textureTileSize - 1) / textureTileSize},
+      rows{(std::max(imageSize.height(), 0) + textureTileSize - 1) / textureTileSize},
+      flags{std::make_unique<std::atomic<bool>[]>(static_cast<size_t>(columns) * rows)}
 {
-    if (std::abs(c) > 2)
-        return 1;
-    else
-    {
-        auto zSquaredPlusC = c;
-        for (int i = 0; i < 25; ++i)
-        {
-            zSquaredPlusC = std::pow(zSquaredPlusC, 2) + c;
-            if (boost::multiprecision::pow(zSquaredPlusC.real(), 2) + boost::multiprecision::pow(zSquaredPlusC.imag(), 2) > 4)
-                return i + 1;
-        }
-        return 0;
-    }
+    markAll();
 }
 
-// <https://en.wikipedia.org/wiki/Burning_Ship_fractal> was instrumental in creating this function
-int calculateBurningShipPoint(const complex &c)
+QRect FractalView::DirtyTiles::tileRect(int index) const
 {
-    if (std::abs(c) > 2)
-        return 1;
-    else
-    {
-        auto zSquaredPlusC = complex{boost::multiprecision::abs(c.real()), boost::multiprecision::abs(c.imag())};
-        for (int i = 0; i < 25; ++i)
-        {
-            auto temp = std::pow(zSquaredPlusC, 2) + c;
-            zSquaredPlusC = complex{boost::multiprecision::abs(temp.real()), boost::multiprecision::abs(temp.imag())};
-            if (boost::multiprecision::pow(zSquaredPlusC.real(), 2) + boost::multiprecision::pow(zSquaredPlusC.imag(), 2) > 4)
-                return i + 1;
-        }
-        return 0;
-    }
+    const int left = index % columns * textureTileSize;
+    const int top = index / columns * textureTileSize;
+    return QRect{left, top, std::min(textureTileSize, imageSize.width() - left), std::min(textureTileSize, imageSize.height() - top)};
+}
+
+void FractalView::DirtyTiles::mark(const QRect &area)
+{
+    const int lastColumn = std::min((area.left() + area.width() - 1) / textureTileSize, columns - 1);
+    const int lastRow = std::min((area.top() + area.height() - 1) / textureTileSize, rows - 1);
+    for (int row = std::max(area.top(), 0) / textureTileSize; row <= lastRow; ++row)
+        for (int column = std::max(area.left(), 0) / textureTileSize; column <= lastColumn; ++column)
+            flags[static_cast<size_t>(row) * columns + column].store(true, std::memory_order_relaxed);
 }
 
-void FractalView::paint(QPainter *painter)
+void FractalView::DirtyTiles::markAll()
+{
+    for (int i = 0; i < tileCount(); ++i)
+        flags[i].store(true, std::memory_order_relaxed);
+}
+
+bool FractalView::DirtyTiles::take(int index)
+{
+    return flags[index].exchange(false, std::memory_order_relaxed);
+}
+
+void FractalView::updatePolish()
 {
     for (auto &rect : m_fractalRects)
         if (rect.visualRect().isEmpty())
             rect.setVisualRect(boundingRect());
     if (m_image.size().isEmpty())
-        m_image = QImage{boundingRect().size().toSize(), QImage::Format_ARGB32};
+        resizeImage();
 
     if (width() != m_width || height() != m_height)
     {
+        cancelRender();
         m_width = width();
         m_height = height();
         for (auto &rect : m_fractalRects)
             rect.setVisualRect(boundingRect());
-        m_image = QImage{boundingRect().size().toSize(), QImage::Format_ARGB32};
+        resizeImage();
         m_isFullyLoaded = false;
     }
 
     if (!m_isFullyLoaded && !m_isLoading)
     {
+        // this recolors the pixels we're keeping, so it has to happen before the render counts as loading
+        if (updateAutoIterations())
+            updatePalette();
+
         m_isLoading = true;
         emit isLoadingChanged();
 
-        m_image.fill(Qt::transparent);
+        m_fillMismatches = 0;
+        emit fillMismatchesChanged();
 
-        auto fut = QtConcurrent::run([this] {
-            const auto fragments = std::min(QThread::idealThreadCount() * 64, static_cast<int>(width() * height()));
-            auto list = m_fractalRects[m_type].split(fragments);
+        auto job = std::make_shared<RenderJob>();
+        job->generation = ++m_generation;
+        job->view = getCurrentFractalRect();
+        // the view keeps every digit it's been given, but after zooming back out the render needs far fewer of them
+        job->view.setPrecision(job->view.requiredDigits());
+        job->formula = m_type;
+        job->juliaPos = m_juliaPos;
+        job->maxIterations = m_maxIterations;
+        job->renderMode = m_renderMode;
+        job->verifyFill = m_verifyFill;
+        job->hasPreview = m_hasPreview;
+        job->deepZoom = m_deepZoom;
+        // pick the scalar type once per render; zooming in far enough automatically moves us on to a more precise one.
+        // The orbit densities are always worked out in double.
+        job->precision = drawsDensity(m_renderMode, m_type) ? Precision::Double : job->view.requiredPrecision();
+        updatePrecision(*job);
+        job->palette = std::atomic_load(&m_palette);
+        // only the pixels that are still notCalculated get rendered; rerender() clears everything, while panning and
+        // zooming keep whatever pixels they can
+        // bits() detaches the image if it needs to; doing that here, before any workers exist, means they can share the
+        // pixel buffer without ever triggering a detach themselves
+        job->pixels = m_image.bits();
+        job->bytesPerLine = m_image.bytesPerLine();
+        job->iterations = m_iterations.data();
+        job->width = m_image.width();
+        job->height = m_image.height();
+        if (m_telemetry)
+            job->telemetry = std::make_shared<RenderTelemetry>(QThread::idealThreadCount());
+        job->dirtyTiles = m_dirtyTiles;
+        m_job = job;
+        updateFocus();
 
-            m_remainingFragmentsMutex.lock();
-            m_remainingFragments = fragments;
-            m_remainingFragmentsMutex.unlock();
+        m_renders.erase(std::remove_if(m_renders.begin(), m_renders.end(), [](const QFuture<void> &render) { return render.isFinished(); }),
+                        m_renders.end());
+        m_renders.push_back(QtConcurrent::run([this, job] {
+            if (drawsDensity(job->renderMode, job->formula))
+            {
+                renderDensity(job);
+                if (job->telemetry)
+                    job->telemetry->finishRender();
+                QMetaObject::invokeMethod(this, [this, job] { finishRender(job); }, Qt::QueuedConnection);
+                return;
+            }
 
-            QtConcurrent::blockingMap(list, [this](FractalRect &rect) {
-                const auto &vr{rect.visualRect()};
+            // the reference orbit starts out from plain numbers, which have to get the view's digits as well
+            PrecisionGuard precisionGuard{job->view.precision()};
+            auto tiles = TileScheduler::tiles(QSize{job->width, job->height});
+            // where the view straddles the axis (or the center) of the formula's symmetry, the tiles on one side of it
+            // don't get calculated at all; every pass copies them over from their mirror image once it's done
+            const Mirror mirror{job->view, formulaInfo(job->formula).symmetry};
+            QVector<QRect> mirroredTiles;
+            if (mirror.isValid())
+            {
+                const auto mirrored = std::stable_partition(tiles.begin(), tiles.end(), [&](const QRect &tile) { return !mirror.covers(tile); });
+                std::copy(mirrored, tiles.end(), std::back_inserter(mirroredTiles));
+                tiles.erase(mirrored, tiles.end());
+            }
+            // Mariani-Silver goes over every tile just once; it's fast enough to not need the coarse passes
+            const bool tracing = job->renderMode == RenderMode::MarianiSilver;
 
-                QImage fragment{vr.size().toSize(), QImage::Format_ARGB32};
-                fragment.fill(Qt::transparent);
-                QPainter painter;
+            // past long double, iterating every pixel in software floats gets painfully slow, so deep zooms switch over to
+            // tracking each pixel as a small offset from a single high precision reference orbit (for the formulas that
+            // Perturbation knows, that is)
+            std::unique_ptr<ViewPerturbation> perturbation;
+            if (usesPerturbation(job->formula, job->deepZoom, job->precision))
+            {
+                RenderTelemetry::Event orbitEvent;
+                if (job->telemetry)
+                    orbitEvent = job->telemetry->start("reference orbit");
 
-                auto endX = vr.x() + vr.width();
-                auto endY = vr.y() + vr.height();
-                if (auto diff = std::abs(endX - static_cast<int>(endX)); diff > 0)
-                    endX += (1 - diff);
-                if (auto diff = std::abs(endY - static_cast<int>(endY)); diff > 0)
-                    endY += (1 - diff);
+                perturbation = std::make_unique<ViewPerturbation>(job->view, job->formula, job->juliaPos, job->maxIterations, &job->cancelled);
 
-                for (int i = static_cast<int>(vr.x()); i <= endX; ++i)
-                {
-                    if (m_cancelRenderRequested)
-                        break;
+                if (job->telemetry)
+                    job->telemetry->finish(orbitEvent);
+            }
 
-                    painter.begin(&fragment);
+            // a quick coarse pass gets something onto the screen right away, and every finer pass only does the pixels the
+            // passes before it haven't
+            const int firstBlockSize = tracing ? 1 : coarsestBlockSize;
+            for (int blockSize = firstBlockSize; blockSize >= 1 && !job->cancelled; blockSize /= 2)
+            {
+                RenderTelemetry::Event passEvent;
+                if (job->telemetry)
+                    passEvent = job->telemetry->start("pass");
 
-                    for (int j = static_cast<int>(vr.y()); j <= endY; ++j)
-                    {
-                        if (m_cancelRenderRequested)
-                            break;
+                job->scheduler.run(tiles, QThread::idealThreadCount(), [&](const QRect &tile) {
+                    // a cancelled job still has to drain its queues, but every tile that's left is dropped straight away
+                    if (job->cancelled)
+                        return;
+
+                    PrecisionGuard precisionGuard{job->view.precision()};
 
-                        if (width() != m_width || height() != m_height)
-                            return;
+                    // tiles we've seen before skip straight to the finished pixels, which the finer passes then leave alone
+                    if (blockSize == firstBlockSize && loadCachedTile(*job, tile, blockSize))
+                        return;
 
-                        complex num = rect.getFractalValueFromVisualPoint(i, j);
-                        int result{};
-                        switch (m_type)
+                    if (perturbation)
+                        perturbation->visit([&](const auto &offsets, const auto &spacing) {
+                            renderPerturbedFragment(*job, tile, blockSize, offsets, perturbation->referencePixel(), spacing);
+                        });
+                    else
+                    {
+                        switch (job->precision)
                         {
-                        case Type::Mandelbrot:
-                            result = calculateMandelbrotPoint(num);
+                        case Precision::Double:
+                            renderDirectFragment<double>(*job, tile, blockSize);
                             break;
-                        case Type::Julia:
-                            result = calculateJuliaPoint(num, m_juliaPos);
+                        case Precision::LongDouble:
+                            renderDirectFragment<long double>(*job, tile, blockSize);
                             break;
-                        case Type::BurningShip:
-                            result = calculateBurningShipPoint(num);
+#ifdef FRACTURE_HAS_FLOAT128
+                        case Precision::Float128:
+                            renderDirectFragment<__float128>(*job, tile, blockSize);
                             break;
+#endif
                         default:
+                            renderDirectFragment<big_float>(*job, tile, blockSize);
                             break;
                         }
-
-                        if (result == 0)
-                            painter.setPen(QPen{QColor{0, 0, 0}});
-                        else
-                            painter.setPen(QPen{
-                                               QColor{255 - std::min(static_cast<int>(255 / result / 0.8) + 50, 255),
-                                                      255 - std::min(static_cast<int>(255 / result / 2) + 50, 255),
-                                                      255 - std::min(static_cast<int>(255 / result / 4) + 50, 255)}
-                                           });
-                        painter.drawPoint(i - vr.x(), j - vr.y());
                     }
-                    painter.end();
-
-                    m_imageMutex.lock();
-                    painter.begin(&m_image);
-                    painter.drawImage(vr, fragment);
-                    painter.end();
-                    m_imageMutex.unlock();
-                    emit updateView();
+
+                    if (blockSize == 1)
+                        storeCachedTile(*job, tile);
+                });
+
+                if (!mirroredTiles.isEmpty())
+                    mirrorTiles(*job, mirror, mirroredTiles, blockSize == 1);
+
+                if (job->telemetry)
+                {
+                    job->telemetry->finish(passEvent);
+                    QMetaObject::invokeMethod(this, [this, job] { updateFrameStats(job); }, Qt::QueuedConnection);
                 }
+            }
 
-                m_remainingFragmentsMutex.lock();
-                --m_remainingFragments;
-                m_remainingFragmentsMutex.unlock();
-            });
+            if (job->telemetry)
+                job->telemetry->finishRender();
+
+            // a newer render may have started in the meantime, so let the GUI thread sort out whether this one still counts
+            QMetaObject::invokeMethod(this, [this, job] { finishRender(job); }, Qt::QueuedConnection);
+        }));
+    }
+}
+
+QSGNode *FractalView::updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *)
+{
+    // whatever the workers mark from here on needs another frame
+    m_updatePending = false;
+
+    RenderTelemetry::Event paintEvent;
+    if (m_job && m_job->telemetry)
+        paintEvent = m_job->telemetry->start("paint");
+
+    auto root = oldNode ? oldNode : new QSGNode;
+    auto &dirtyTiles = *m_dirtyTiles;
+    if (m_sceneImageSize != m_image.size())
+    {
+        while (auto node = root->firstChild())
+        {
+            root->removeChildNode(node);
+            delete node;
+        }
+        for (int i = 0; i < dirtyTiles.tileCount(); ++i)
+            root->appendChildNode(new TileNode);
+        dirtyTiles.markAll();
+        m_sceneImageSize = m_image.size();
+    }
+
+    // the image is the size of the item, except for the moment between a resize and the next polish
+    const double scaleX = m_image.width() > 0 ? width() / m_image.width() : 1;
+    const double scaleY = m_image.height() > 0 ? height() / m_image.height() : 1;
+    // the dirty tiles get copied out while the workers are kept from writing to the frame, which they only ever do
+    // while holding the lock for reading, so no copy catches a row halfway; whatever they mark after this gets uploaded
+    // next frame. The uploads themselves happen once they're free to go on again.
+    std::vector<std::pair<TileNode *, QImage>> uploads;
+    {
+        QWriteLocker locker{&m_frameLock};
+        int index = 0;
+        for (auto node = root->firstChild(); node; node = node->nextSibling(), ++index)
+        {
+            auto tileNode = static_cast<TileNode *>(node);
+            const QRect tile = dirtyTiles.tileRect(index);
+            tileNode->setRect(QRectF{tile.x() * scaleX, tile.y() * scaleY, tile.width() * scaleX, tile.height() * scaleY});
+            if (dirtyTiles.take(index))
+                uploads.emplace_back(tileNode, m_image.copy(tile));
+        }
+    }
+    for (const auto &[tileNode, pixels] : uploads)
+        tileNode->replaceTexture(window()->createTextureFromImage(pixels));
+
+    if (m_job && m_job->telemetry)
+        m_job->telemetry->finish(paintEvent);
+    return root;
+}
+
+void FractalView::markDirty(RenderJob &job, const QRect &area)
+{
+    job.dirtyTiles->mark(area);
+    if (!m_updatePending.exchange(true))
+        emit updateView();
+}
+
+void FractalView::markAllDirty()
+{
+    m_dirtyTiles->markAll();
+    update();
+}
+
+void FractalView::finishRender(const std::shared_ptr<RenderJob> &job)
+{
+    if (job->generation != m_generation)
+        return;
+
+    // the workers color each row with whatever palette is current at the time, so if it changed while we were
+    // rendering some rows may still have the old colors
+    if (std::atomic_load(&m_palette) != job->palette)
+        recolor();
+
+    if (job->renderMode == RenderMode::MarianiSilver && job->verifyFill)
+    {
+        m_fillMismatches = job->fillMismatches.load();
+        emit fillMismatchesChanged();
+    }
+
+    if (job->telemetry)
+    {
+        updateFrameStats(job);
+        m_lastTelemetry = job->telemetry;
+    }
+
+    m_job.reset();
+    m_isFullyLoaded = true;
+    m_isLoading = false;
+    emit isLoadingChanged();
+    update();
+}
+
+void FractalView::updateFrameStats(const std::shared_ptr<RenderJob> &job)
+{
+    if (job->generation != m_generation)
+        return;
+
+    m_frameStats = job->telemetry->summary();
+    emit frameStatsChanged();
+}
+
+double FractalView::megapixelsPerSecond() const
+{
+    return m_frameStats.milliseconds > 0 ? m_frameStats.pixels / m_frameStats.milliseconds / 1e3 : 0;
+}
+
+double FractalView::gigaiterationsPerSecond() const
+{
+    return m_frameStats.milliseconds > 0 ? m_frameStats.iterations / m_frameStats.milliseconds / 1e6 : 0;
+}
+
+double FractalView::megasamplesPerSecond() const
+{
+    return m_frameStats.milliseconds > 0 ? m_frameStats.samples / m_frameStats.milliseconds / 1e3 : 0;
+}
+
+bool FractalView::drawsDensity(RenderMode mode, Formula formula)
+{
+    return (mode == RenderMode::Buddhabrot || mode == RenderMode::AntiBuddhabrot) && ::Buddhabrot::supports(formula);
+}
+
+void FractalView::renderDensity(const std::shared_ptr<RenderJob> &job)
+{
+    ::Buddhabrot::Settings settings;
+    settings.formula = job->formula;
+    settings.juliaConstant = job->juliaPos;
+    settings.maxIterations = job->maxIterations;
+    settings.anti = job->renderMode == RenderMode::AntiBuddhabrot;
+    settings.threads = QThread::idealThreadCount();
+    ::Buddhabrot buddhabrot{job->view, settings};
+
+    const qint64 pixels = static_cast<qint64>(job->width) * job->height;
+    const qint64 total = pixels * densitySamplesPerPixel;
+    std::vector<float> values(static_cast<size_t>(pixels));
+    for (qint64 batch = std::max(pixels / 4, qint64{1}); buddhabrot.samples() < total && !job->cancelled; batch = buddhabrot.samples())
+    {
+        RenderTelemetry::Event passEvent;
+        if (job->telemetry)
+            passEvent = job->telemetry->start("pass");
+
+        if (!buddhabrot.sample(std::min(batch, total - buddhabrot.samples()), &job->cancelled, job->telemetry.get()))
+            return;
+
+        // every pixel changes with every batch, and the histogram doesn't care which pixels the previous view left
+        // behind, so the whole image gets replaced
+        buddhabrot.toneMap(values.data());
+        {
+            QReadLocker locker{&m_frameLock};
+            if (job->cancelled)
+                return;
+
+            const auto palette = std::atomic_load(&m_palette);
+            for (int j = 0; j < job->height; ++j)
+            {
+                float *rowValues = job->iterations + static_cast<size_t>(j) * job->width;
+                std::copy_n(values.data() + static_cast<size_t>(j) * job->width, job->width, rowValues);
+                palette->colorize(rowValues, reinterpret_cast<QRgb *>(job->pixels + j * job->bytesPerLine), job->width);
+            }
+            markDirty(*job, QRect{0, 0, job->width, job->height});
+        }
+
+        if (job->telemetry)
+        {
+            job->telemetry->finish(passEvent);
+            QMetaObject::invokeMethod(this, [this, job] { updateFrameStats(job); }, Qt::QueuedConnection);
+        }
+    }
+}
+
+TileCache::Key FractalView::cacheKey(const RenderJob &job, const QRect &tile)
+{
+    TileCache::Key key;
+    key.formula = job.formula;
+    key.juliaConstant = job.juliaPos;
+    key.maxIterations = job.maxIterations;
+    key.view = job.view;
+    key.tile = tile;
+    // Mariani-Silver's fills can differ from the real thing, and perturbation rounds differently from the direct kernels
+    key.variant = QByteArray::number(static_cast<int>(job.renderMode));
+    if (usesPerturbation(job.formula, job.deepZoom, job.precision))
+        key.variant += " perturbed";
+    return key;
+}
+
+bool FractalView::loadCachedTile(RenderJob &job, const QRect &tile, int blockSize)
+{
+    RenderTelemetry::Event event;
+    if (job.telemetry)
+        event = job.telemetry->start("cached tile", tile, blockSize);
+
+    std::vector<float> values;
+    if (!m_tileCache.find(TileCache::hash(cacheKey(job, tile)), tile.size(), values))
+        return false;
+
+    QReadLocker locker{&m_frameLock};
+    if (job.cancelled)
+        return true;
+
+    const auto palette = std::atomic_load(&m_palette);
+    for (int row = 0; row < tile.height(); ++row)
+    {
+        const int j = tile.top() + row;
+        float *rowValues = job.iterations + static_cast<size_t>(j) * job.width + tile.left();
+        std::copy_n(values.data() + static_cast<size_t>(row) * tile.width(), tile.width(), rowValues);
+        palette->colorize(rowValues, reinterpret_cast<QRgb *>(job.pixels + j * job.bytesPerLine) + tile.left(), tile.width());
+    }
+    markDirty(job, tile);
+
+    if (job.telemetry)
+        job.telemetry->finish(event);
+    return true;
+}
+
+void FractalView::storeCachedTile(RenderJob &job, const QRect &tile)
+{
+    std::vector<float> values(static_cast<size_t>(tile.width()) * tile.height());
+    {
+        QReadLocker locker{&m_frameLock};
+        if (job.cancelled)
+            return;
+
+        for (int row = 0; row < tile.height(); ++row)
+            std::copy_n(job.iterations + static_cast<size_t>(tile.top() + row) * job.width + tile.left(), tile.width(),
+                        values.data() + static_cast<size_t>(row) * tile.width());
+    }
+
+    // a tile that got cut short somewhere isn't finished
+    if (std::find(values.begin(), values.end(), Palette::notCalculated) != values.end())
+        return;
+    m_tileCache.insert(TileCache::hash(cacheKey(job, tile)), tile.size(), values);
+}
+
+void FractalView::mirrorTiles(RenderJob &job, const Mirror &mirror, const QVector<QRect> &tiles, bool finished)
+{
+    RenderTelemetry::Event event;
+    if (job.telemetry)
+        event = job.telemetry->start("mirror");
+
+    {
+        QReadLocker locker{&m_frameLock};
+        if (job.cancelled)
+            return;
+
+        for (const QRect &tile : tiles)
+        {
+            for (int j = tile.top(); j <= tile.bottom(); ++j)
+            {
+                float *rowValues = job.iterations + static_cast<size_t>(j) * job.width;
+                auto line = reinterpret_cast<QRgb *>(job.pixels + j * job.bytesPerLine);
+                for (int i = tile.left(); i <= tile.right(); ++i)
+                {
+                    // pixels the previous view left behind are as good as mirrored ones
+                    if (rowValues[i] != Palette::notCalculated)
+                        continue;
+
+                    // a source pixel the coarse passes haven't got to yet still has a color, from the block stretched
+                    // over it, so the mirrored side gets the same preview
+                    const QPoint source = mirror.source(QPoint{i, j});
+                    rowValues[i] = job.iterations[static_cast<size_t>(source.y()) * job.width + source.x()];
+                    line[i] = reinterpret_cast<const QRgb *>(job.pixels + source.y() * job.bytesPerLine)[source.x()];
+                }
+            }
+            markDirty(job, tile);
+        }
+    }
+
+    if (finished)
+        for (const QRect &tile : tiles)
+            storeCachedTile(job, tile);
+
+    if (job.telemetry)
+        job.telemetry->finish(event);
+}
+
+template<typename Calculator>
+void FractalView::renderFragment(RenderJob &job, const QRect &tile, int blockSize, const Calculator &calculate)
+{
+    if (!job.telemetry)
+    {
+        renderTile(job, tile, blockSize, calculate);
+        return;
+    }
+
+    // the timing and counting only get compiled into this copy of the tile loop, so with telemetry off it costs
+    // nothing past the check above
+    auto event = job.telemetry->start("tile", tile, blockSize);
+    QElapsedTimer timer;
+    renderTile(job, tile, blockSize, [&](int row, const int *columns, int count, float *results) {
+        timer.start();
+        const bool finished = calculate(row, columns, count, results);
+        event.calculating += timer.nsecsElapsed();
+        if (finished)
+            RenderTelemetry::addPixels(event, results, count, job.maxIterations);
+        return finished;
+    });
+    job.telemetry->finish(event);
+}
+
+template<typename Calculator>
+void FractalView::renderTile(RenderJob &job, const QRect &tile, int blockSize, const Calculator &calculate)
+{
+    // the tiles don't overlap, so they can all write into the frame at the same time without getting in each other's
+    // way. The blocks the coarse passes stretch their pixels over are laid out on a grid over the whole image and the
+    // tile size is a multiple of the block size, so those never stick out of their tile either.
+    const int firstColumn = tile.left();
+    const int endColumn = tile.left() + tile.width();
+    const int firstRow = tile.top();
+    const int endRow = tile.top() + tile.height();
+    if (firstColumn >= endColumn)
+        return;
+
+    std::vector<int> columns;
+    std::vector<float> values;
+    if (job.renderMode == RenderMode::MarianiSilver)
+    {
+        // calculate the outline of the whole fragment, then trace everything inside it
+        const int count = endColumn - firstColumn;
+        if (!calculateRun(job, firstRow, firstColumn, 1, count, calculate, columns, values))
+            return;
+        if (endRow - firstRow > 1 && !calculateRun(job, endRow - 1, firstColumn, 1, count, calculate, columns, values))
+            return;
+        for (int j = firstRow + 1; j < endRow - 1; ++j)
+            if (!calculateRun(job, j, firstColumn, std::max(count - 1, 1), std::min(count, 2), calculate, columns, values))
+                return;
+        markDirty(job, tile);
+
+        traceRect(job, firstColumn, firstRow, endColumn, endRow, calculate, columns, values);
+        return;
+    }
+
+    const int start = (firstColumn + blockSize - 1) / blockSize * blockSize;
+    for (int j = (firstRow + blockSize - 1) / blockSize * blockSize; j < endRow; j += blockSize)
+    {
+        // the pixels on this pass's grid that neither a coarser pass nor the previous view has filled in yet
+        float *rowValues = job.iterations + static_cast<size_t>(j) * job.width;
+        {
+            QReadLocker locker{&m_frameLock};
+            if (job.cancelled)
+                return;
+
+            columns.clear();
+            for (int column = start; column < endColumn; column += blockSize)
+                if (rowValues[column] == Palette::notCalculated)
+                    columns.push_back(column);
+        }
+        if (columns.empty())
+            continue;
+
+        // a whole row is calculated in one go so that the vectorized kernels have something to chew on; this happens
+        // without holding the lock, so a cancel never has to wait for a calculation
+        const int count = static_cast<int>(columns.size());
+        values.resize(count);
+        if (!calculate(j, columns.data(), count, values.data()))
+            return;
+
+        QReadLocker locker{&m_frameLock};
+        if (job.cancelled)
+            return;
+
+        const auto palette = std::atomic_load(&m_palette);
+        const int stretch = job.hasPreview ? 1 : blockSize;
+        const int blockHeight = std::min(stretch, job.height - j);
+        for (int i = 0; i < count; ++i)
+        {
+            const int column = columns[i];
+            const QRgb color = palette->color(values[i]);
+            const int blockWidth = std::min(stretch, job.width - column);
+            // stretch the pixel over its block as a preview, but leave the pixels we already know alone
+            for (int y = 0; y < blockHeight; ++y)
+            {
+                const float *blockValues = rowValues + static_cast<size_t>(y) * job.width;
+                auto line = reinterpret_cast<QRgb *>(job.pixels + (j + y) * job.bytesPerLine);
+                for (int x = column; x < column + blockWidth; ++x)
+                    if (blockValues[x] == Palette::notCalculated)
+                        line[x] = color;
+            }
+            rowValues[column] = values[i];
+        }
+
+        markDirty(job, QRect{firstColumn, j, endColumn - firstColumn, blockHeight});
+    }
+}
+
+template<typename Calculator>
+bool FractalView::calculateRun(RenderJob &job, int row, int firstColumn, int columnStep, int count, const Calculator &calculate,
+                               std::vector<int> &columns, std::vector<float> &scratch)
+{
+    float *rowValues = job.iterations + static_cast<size_t>(row) * job.width;
+    {
+        QReadLocker locker{&m_frameLock};
+        if (job.cancelled)
+            return false;
+
+        columns.clear();
+        for (int i = 0; i < count; ++i)
+            if (rowValues[firstColumn + i * columnStep] == Palette::notCalculated)
+                columns.push_back(firstColumn + i * columnStep);
+    }
+    if (columns.empty())
+        return true;
+
+    scratch.resize(columns.size());
+    if (!calculate(row, columns.data(), static_cast<int>(columns.size()), scratch.data()))
+        return false;
+
+    QReadLocker locker{&m_frameLock};
+    if (job.cancelled)
+        return false;
+
+    const auto palette = std::atomic_load(&m_palette);
+    auto line = reinterpret_cast<QRgb *>(job.pixels + row * job.bytesPerLine);
+    for (size_t i = 0; i < columns.size(); ++i)
+    {
+        rowValues[columns[i]] = scratch[i];
+        line[columns[i]] = palette->color(scratch[i]);
+    }
+    return true;
+}
+
+template<typename Calculator>
+bool FractalView::traceRect(RenderJob &job, int left, int top, int right, int bottom, const Calculator &calculate, std::vector<int> &columns,
+                            std::vector<float> &scratch)
+{
+    const int interiorWidth = right - left - 2;
+    const int interiorHeight = bottom - top - 2;
+    if (interiorWidth <= 0 || interiorHeight <= 0)
+        return true;
+
+    auto iterations = [&](int column, int row) {
+        return static_cast<int>(job.iterations[static_cast<size_t>(row) * job.width + column]);
+    };
 
-            m_isFullyLoaded = true;
-            m_isLoading = false;
-            emit isLoadingChanged();
-            emit updateView();
-        });
+    bool uniform = true;
+    {
+        QReadLocker locker{&m_frameLock};
+        if (job.cancelled)
+            return false;
+
+        const int outline = iterations(left, top);
+        for (int column = left; column < right && uniform; ++column)
+            uniform = iterations(column, top) == outline && iterations(column, bottom - 1) == outline;
+        for (int row = top + 1; row < bottom - 1 && uniform; ++row)
+            uniform = iterations(left, row) == outline && iterations(right - 1, row) == outline;
+    }
+    if (uniform)
+        return fillRect(job, left, top, right, bottom, calculate, columns, scratch);
+
+    // below this size, cutting the rectangle up any further costs more than it saves
+    constexpr int smallestTracedArea = 64;
+    if (interiorWidth * interiorHeight <= smallestTracedArea)
+    {
+        for (int row = top + 1; row < bottom - 1; ++row)
+            if (!calculateRun(job, row, left + 1, 1, interiorWidth, calculate, columns, scratch))
+                return false;
+        markDirty(job, QRect{left, top, right - left, bottom - top});
+        return true;
+    }
+
+    // cut across the longer side; the line we cut along becomes part of the outline of both halves
+    if (right - left >= bottom - top)
+    {
+        const int middle = (left + right) / 2;
+        for (int row = top + 1; row < bottom - 1; ++row)
+            if (!calculateRun(job, row, middle, 1, 1, calculate, columns, scratch))
+                return false;
+        return traceRect(job, left, top, middle + 1, bottom, calculate, columns, scratch) &&
+                traceRect(job, middle, top, right, bottom, calculate, columns, scratch);
+    }
+
+    const int middle = (top + bottom) / 2;
+    if (!calculateRun(job, middle, left + 1, 1, interiorWidth, calculate, columns, scratch))
+        return false;
+    return traceRect(job, left, top, right, middle + 1, calculate, columns, scratch) &&
+            traceRect(job, left, middle, right, bottom, calculate, columns, scratch);
+}
+
+template<typename Calculator>
+bool FractalView::fillRect(RenderJob &job, int left, int top, int right, int bottom, const Calculator &calculate, std::vector<int> &columns,
+                           std::vector<float> &scratch)
+{
+    std::vector<float> filled;
+    for (int row = top + 1; row < bottom - 1; ++row)
+    {
+        float *rowValues = job.iterations + static_cast<size_t>(row) * job.width;
+        auto line = reinterpret_cast<QRgb *>(job.pixels + row * job.bytesPerLine);
+
+        {
+            QReadLocker locker{&m_frameLock};
+            if (job.cancelled)
+                return false;
+
+            // the integer part is the same all the way around the outline, but the smoothed fraction isn't; blending
+            // between the left and right edges keeps the smooth coloring smooth
+            const auto palette = std::atomic_load(&m_palette);
+            const float leftValue = rowValues[left];
+            const float rightValue = rowValues[right - 1];
+            const float highest = std::max(leftValue, rightValue);
+            columns.clear();
+            filled.clear();
+            for (int column = left + 1; column < right - 1; ++column)
+            {
+                if (rowValues[column] != Palette::notCalculated)
+                    continue;
+
+                const float blend = static_cast<float>(column - left) / (right - 1 - left);
+                rowValues[column] = std::min(leftValue + (rightValue - leftValue) * blend, highest);
+                line[column] = palette->color(rowValues[column]);
+                columns.push_back(column);
+                filled.push_back(rowValues[column]);
+            }
+        }
 
-        Q_UNUSED(fut)
+        // the fill is only exact as long as nothing slips in between the pixels of the outline, which thin filaments and
+        // disconnected sets (the Burning Ship, lots of Julia sets) can do, so this checks the iteration counts against
+        // the brute force ones
+        if (job.verifyFill && !columns.empty())
+        {
+            scratch.resize(columns.size());
+            if (!calculate(row, columns.data(), static_cast<int>(columns.size()), scratch.data()) || job.cancelled)
+                return false;
+            int mismatches = 0;
+            for (size_t i = 0; i < columns.size(); ++i)
+                if (static_cast<int>(scratch[i]) != static_cast<int>(filled[i]))
+                    ++mismatches;
+            job.fillMismatches += mismatches;
+        }
     }
 
-    m_imageMutex.lock();
-    painter->drawImage(boundingRect(), m_image);
-    m_imageMutex.unlock();
+    markDirty(job, QRect{left, top, right - left, bottom - top});
+    return true;
 }
 
-void FractalView::setType(Type type)
+template<typename T>
+void FractalView::renderDirectFragment(RenderJob &job, const QRect &tile, int blockSize)
 {
-    if (m_type == type)
+    // map the view onto the fractal plane once per tile and then just step across it in the target precision instead
+    // of doing a full multiprecision mapping for every pixel
+    PixelStepper<T> stepper{job.view};
+    const T &stepReal = stepper.spacing();
+    const KernelParameters<T> parameters{scalar_cast<T>(job.juliaPos.real()), scalar_cast<T>(job.juliaPos.imag()), job.maxIterations,
+                                         periodTolerance(stepReal)};
+
+    // the formula is picked once for the whole tile, and everything below gets instantiated for each of them
+    visitFormula(job.formula, [&](auto formula) {
+        using F = decltype(formula);
+        if constexpr (std::is_same_v<T, double> && F::info.vectorized)
+        {
+            // plain doubles get the vectorized kernels
+            std::vector<double> reals;
+            std::vector<double> imags;
+            renderFragment(job, tile, blockSize, [&](int row, const int *columns, int count, float *results) {
+                reals.resize(count);
+                imags.assign(count, stepper.imag(row));
+                for (int i = 0; i < count; ++i)
+                    reals[i] = stepper.real(columns[i]);
+                calculatePoints(F::info.id, reals.data(), imags.data(), parameters.juliaReal, parameters.juliaImag, job.maxIterations,
+                                parameters.periodTolerance, count, results, &job.cancelled);
+                return !job.cancelled;
+            });
+        }
+        else
+        {
+            renderFragment(job, tile, blockSize, [&](int row, const int *columns, int count, float *results) {
+                const T &imag = stepper.imag(row);
+                for (int i = 0; i < count; ++i)
+                {
+                    if (job.cancelled)
+                        return false;
+                    results[i] = F::calculatePoint(stepper.real(columns[i]), imag, parameters, &job.cancelled);
+                }
+                return !job.cancelled;
+            });
+        }
+    });
+}
+
+template<typename D>
+void FractalView::renderPerturbedFragment(RenderJob &job, const QRect &tile, int blockSize, const Perturbation<D> &perturbation,
+                                          const QPointF &referencePixel, const D &spacing)
+{
+    renderFragment(job, tile, blockSize, [&](int row, const int *columns, int count, float *results) {
+        const D deltaImag = (row - referencePixel.y()) * spacing;
+        for (int i = 0; i < count; ++i)
+        {
+            if (job.cancelled)
+                return false;
+            results[i] = perturbation.calculatePoint((columns[i] - referencePixel.x()) * spacing, deltaImag, &job.cancelled);
+        }
+        return !job.cancelled;
+    });
+}
+
+QVariantList FractalView::formulas() const
+{
+    QVariantList list;
+    for (const auto &formula : ::formulas())
+        list.push_back(QVariantMap{{"name", formula.name}, {"label", QString::fromUtf8(formula.label)}});
+    return list;
+}
+
+int FractalView::formulaIndex(const QString &name) const
+{
+    const auto formula = findFormula(name.toUtf8().constData());
+    return formula ? static_cast<int>(formula->id) : -1;
+}
+
+void FractalView::setType(int type)
+{
+    if (type == static_cast<int>(m_type) || type < 0 || type >= static_cast<int>(::formulas().size()))
         return;
 
     cancelRender();
-    m_type = type;
+    m_type = static_cast<Formula>(type);
+    clearPixels();
     m_isFullyLoaded = false;
     emit typeChanged();
     emit updateView();
 }
 
+QPointF FractalView::fractalPoint(QPointF position)
+{
+    const auto point = getCurrentFractalRect().getFractalValueFromVisualPoint(position);
+    return QPointF{point.real().convert_to<double>(), point.imag().convert_to<double>()};
+}
+
 void FractalView::setJuliaPoint(QPoint point)
 {
-    if (point == m_juliaPoint)
+    // the constant is the point under the cursor on the Mandelbrot set, the same one the Julia preview showed for it,
+    // only in full precision
+    const auto juliaPos = m_fractalRects[static_cast<size_t>(Formula::Mandelbrot)].getFractalValueFromVisualPoint(point);
+    if (point == m_juliaPoint && juliaPos == m_juliaPos)
         return;
 
     m_juliaPoint = point;
+    m_juliaPos = juliaPos;
     emit juliaPointChanged();
 
-    m_juliaPos = m_fractalRects[Type::Julia].getFractalValueFromVisualPoint(m_juliaPoint);
-
-    if (m_type == Type::Julia)
+    if (m_type == Formula::Julia)
         rerender();
 }
 
@@ -237,6 +948,102 @@ void FractalView::setZoomFactor(double factor)
     emit zoomFactorChanged();
 }
 
+void FractalView::setDeepZoom(bool deepZoom)
+{
+    if (m_deepZoom == deepZoom)
+        return;
+
+    m_deepZoom = deepZoom;
+    emit deepZoomChanged();
+    rerender();
+}
+
+void FractalView::setColorScheme(ColorScheme scheme)
+{
+    if (m_colorScheme == scheme)
+        return;
+
+    m_colorScheme = scheme;
+    emit colorSchemeChanged();
+    updatePalette();
+}
+
+void FractalView::setSmoothColoring(bool smooth)
+{
+    if (m_smoothColoring == smooth)
+        return;
+
+    m_smoothColoring = smooth;
+    emit smoothColoringChanged();
+    updatePalette();
+}
+
+void FractalView::setMaxIterations(int iterations)
+{
+    iterations = std::max(iterations, 1);
+    if (m_maxIterations == iterations)
+        return;
+
+    m_maxIterations = iterations;
+    emit maxIterationsChanged();
+    // picking a budget by hand means the user doesn't want it picked for them any more
+    setAutoIterations(false);
+    updatePalette();
+    rerender();
+}
+
+void FractalView::setAutoIterations(bool autoIterations)
+{
+    if (m_autoIterations == autoIterations)
+        return;
+
+    m_autoIterations = autoIterations;
+    emit autoIterationsChanged();
+    if (m_autoIterations)
+        rerender();
+}
+
+void FractalView::setRenderMode(RenderMode mode)
+{
+    if (m_renderMode == mode)
+        return;
+
+    m_renderMode = mode;
+    emit renderModeChanged();
+    rerender();
+}
+
+void FractalView::setVerifyFill(bool verify)
+{
+    if (m_verifyFill == verify)
+        return;
+
+    m_verifyFill = verify;
+    emit verifyFillChanged();
+    if (m_renderMode == RenderMode::MarianiSilver)
+        rerender();
+}
+
+void FractalView::setExportSamples(int samples)
+{
+    samples = std::max(samples, 1);
+    if (m_exportSamples == samples)
+        return;
+
+    m_exportSamples = samples;
+    emit exportSamplesChanged();
+}
+
+void FractalView::setTelemetry(bool telemetry)
+{
+    if (m_telemetry == telemetry)
+        return;
+
+    // this takes effect with the next render
+    m_telemetry = telemetry;
+    emit telemetryChanged();
+}
+
 void FractalView::setXOffset(double offset)
 {
     if (m_xOffset == offset)
@@ -244,6 +1051,7 @@ void FractalView::setXOffset(double offset)
 
     m_xOffset = offset;
     emit xOffsetChanged();
+    updateFocus();
 }
 
 void FractalView::setYOffset(double offset)
@@ -253,6 +1061,7 @@ void FractalView::setYOffset(double offset)
 
     m_yOffset = offset;
     emit yOffsetChanged();
+    updateFocus();
 }
 
 void FractalView::resetZoomFactor()
@@ -284,10 +1093,22 @@ void FractalView::resetYOffset()
 
 void FractalView::cancelRender()
 {
-    m_cancelRenderRequested = true;
-    while (m_remainingFragments > 0)
-        qApp->processEvents();
-    m_cancelRenderRequested = false;
+    if (!m_job)
+        return;
+
+    {
+        // this only has to wait for workers that are in the middle of writing a row; the ones that are calculating
+        // notice the flag by themselves and their results get dropped
+        QWriteLocker locker{&m_frameLock};
+        m_job->cancelled = true;
+        ++m_generation;
+    }
+    m_job.reset();
+
+    // whatever got rendered so far stays on screen; the setters that cancel in order to start over say so themselves
+    m_isFullyLoaded = true;
+    m_isLoading = false;
+    emit isLoadingChanged();
 }
 
 void FractalView::rerender()
@@ -295,6 +1116,7 @@ void FractalView::rerender()
     if (m_isLoading)
         cancelRender();
 
+    clearPixels();
     m_isFullyLoaded = false;
     emit updateView();
 }
@@ -306,21 +1128,19 @@ void FractalView::applyZoomIn()
 
     cancelRender();
 
-    auto &currentRect = m_fractalRects[m_type];
-    const auto complexValuePerPixel = currentRect.width() / boundingRect().width();
-    FractalRect newRect{currentRect.coreX() + (currentRect.coreWidth() - (currentRect.coreWidth() * m_zoomFactor)) / 2 + complexValuePerPixel * m_xOffset,
-                       currentRect.coreY() + (currentRect.coreHeight() - (currentRect.coreHeight() * m_zoomFactor)) / 2 + complexValuePerPixel * m_yOffset,
-                       currentRect.coreWidth() * m_zoomFactor,
-                       currentRect.coreHeight() * m_zoomFactor,
-                       currentRect.visualRect()};
+    auto &currentRect = getCurrentFractalRect();
+    const FractalRect previousRect = currentRect;
+    const FractalRect newRect = currentRect.zoomed(m_zoomFactor, QPointF{m_xOffset, m_yOffset});
 
-    m_fractalRects[m_type] = newRect;
+    currentRect = newRect;
 
     setZoomFactor(1);
     resetXOffset();
     resetYOffset();
 
-    rerender();
+    remapPixels(previousRect, newRect);
+    m_isFullyLoaded = false;
+    emit updateView();
 }
 
 void FractalView::applyZoomOut()
@@ -330,26 +1150,271 @@ void FractalView::applyZoomOut()
 
     cancelRender();
 
-    auto &currentRect = m_fractalRects[m_type];
-    FractalRect newRect{currentRect.coreX() - ((currentRect.coreWidth() / m_zoomFactor) - currentRect.coreWidth()) / 2,
-                       currentRect.coreY() - ((currentRect.coreHeight() / m_zoomFactor) - currentRect.coreHeight()) / 2,
-                       currentRect.coreWidth() / m_zoomFactor,
-                       currentRect.coreHeight() / m_zoomFactor,
-                currentRect.visualRect()};
+    auto &currentRect = getCurrentFractalRect();
+    const FractalRect previousRect = currentRect;
+    const FractalRect newRect = currentRect.zoomed(big_float{1} / m_zoomFactor);
 
-    m_fractalRects[m_type] = newRect;
+    currentRect = newRect;
 
     setZoomFactor(1);
     // NOTE: there is not really a good way to apply offsets while zooming out, so we're ignoring them for this function
     resetXOffset();
     resetYOffset();
 
-    rerender();
+    remapPixels(previousRect, newRect);
+    m_isFullyLoaded = false;
+    emit updateView();
+}
+
+void FractalView::pan(int dx, int dy)
+{
+    if (dx == 0 && dy == 0)
+        return;
+
+    cancelRender();
+    getCurrentFractalRect().translate(dx, dy);
+
+    // the pixels we already have move along with the view, and only the strips that scroll in at the edges are left to
+    // be rendered
+    const int imageWidth = m_image.width();
+    const int imageHeight = m_image.height();
+    QImage image{m_image.size(), m_image.format()};
+    image.fill(Qt::transparent);
+    std::vector<float> iterations(m_iterations.size(), Palette::notCalculated);
+    const int firstColumn = std::max(0, -dx);
+    const int endColumn = std::min(imageWidth, imageWidth - dx);
+    for (int row = std::max(0, -dy); row < std::min(imageHeight, imageHeight - dy) && firstColumn < endColumn; ++row)
+    {
+        std::copy_n(m_iterations.data() + static_cast<size_t>(row + dy) * imageWidth + firstColumn + dx, endColumn - firstColumn,
+                    iterations.data() + static_cast<size_t>(row) * imageWidth + firstColumn);
+        std::copy_n(reinterpret_cast<const QRgb *>(m_image.constScanLine(row + dy)) + firstColumn + dx, endColumn - firstColumn,
+                    reinterpret_cast<QRgb *>(image.scanLine(row)) + firstColumn);
+    }
+
+    m_image = image;
+    m_iterations = std::move(iterations);
+    m_hasPreview = false;
+    m_isFullyLoaded = false;
+    markAllDirty();
+    emit updateView();
+}
+
+FractalRect &FractalView::getCurrentFractalRect()
+{
+    return m_fractalRects[static_cast<size_t>(m_type)];
+}
+
+void FractalView::resizeImage()
+{
+    m_image = QImage{boundingRect().size().toSize(), QImage::Format_ARGB32};
+    m_iterations.resize(static_cast<size_t>(m_image.width()) * m_image.height());
+    // a render of the old size may still mark the old tiles for a moment
+    m_dirtyTiles = std::make_shared<DirtyTiles>(m_image.size());
+    clearPixels();
+}
+
+void FractalView::clearPixels()
+{
+    m_image.fill(Qt::transparent);
+    std::fill(m_iterations.begin(), m_iterations.end(), Palette::notCalculated);
+    m_hasPreview = false;
+    markAllDirty();
+}
+
+void FractalView::remapPixels(const FractalRect &from, const FractalRect &to)
+{
+    const int imageWidth = m_image.width();
+    const int imageHeight = m_image.height();
+
+    // works out which old pixel every new column (or row) ends up closest to, and whether it sits right on top of it,
+    // as happens with 2x zooms; offset and scale say where the new pixels are in old pixels
+    auto mapAxis = [](const big_float &offset, const big_float &scale, int size, std::vector<int> &sources, std::vector<bool> &exact) {
+        const double start = offset.convert_to<double>();
+        const double step = scale.convert_to<double>();
+        sources.resize(size);
+        exact.resize(size);
+        for (int i = 0; i < size; ++i)
+        {
+            const double position = start + step * i;
+            const double nearest = std::round(position);
+            sources[i] = nearest >= 0 && nearest < size ? static_cast<int>(nearest) : -1;
+            exact[i] = std::abs(position - nearest) < 1e-6;
+        }
+    };
+
+    const big_float fromSpacingX = from.width() / from.visualRect().width();
+    const big_float fromSpacingY = from.height() / from.visualRect().height();
+    std::vector<int> sourceColumns;
+    std::vector<int> sourceRows;
+    std::vector<bool> exactColumns;
+    std::vector<bool> exactRows;
+    mapAxis((to.x() - from.x()) / fromSpacingX, to.width() / to.visualRect().width() / fromSpacingX, imageWidth, sourceColumns, exactColumns);
+    mapAxis((to.y() - from.y()) / fromSpacingY, to.height() / to.visualRect().height() / fromSpacingY, imageHeight, sourceRows, exactRows);
+
+    QImage image{m_image.size(), m_image.format()};
+    image.fill(Qt::transparent);
+    std::vector<float> iterations(m_iterations.size(), Palette::notCalculated);
+    for (int row = 0; row < imageHeight; ++row)
+    {
+        if (sourceRows[row] < 0)
+            continue;
+
+        auto line = reinterpret_cast<QRgb *>(image.scanLine(row));
+        float *values = iterations.data() + static_cast<size_t>(row) * imageWidth;
+        const auto sourceLine = reinterpret_cast<const QRgb *>(m_image.constScanLine(sourceRows[row]));
+        const float *sourceValues = m_iterations.data() + static_cast<size_t>(sourceRows[row]) * imageWidth;
+        for (int column = 0; column < imageWidth; ++column)
+        {
+            const int source = sourceColumns[column];
+            if (source < 0)
+                continue;
+
+            line[column] = sourceLine[source];
+            if (exactRows[row] && exactColumns[column])
+                values[column] = sourceValues[source];
+        }
+    }
+
+    m_image = image;
+    m_iterations = std::move(iterations);
+    m_hasPreview = true;
+    markAllDirty();
+}
+
+void FractalView::updatePalette()
+{
+    std::atomic_store(&m_palette, std::shared_ptr<const Palette>{
+                          std::make_shared<Palette>(static_cast<Palette::Scheme>(m_colorScheme), m_maxIterations, m_smoothColoring)});
+
+    // a running render recolors everything once it's done anyway
+    if (m_isLoading)
+        return;
+
+    recolor();
+    update();
+}
+
+bool FractalView::updateAutoIterations()
+{
+    if (!m_autoIterations)
+        return false;
+
+    const int budget = autoIterationBudget(getCurrentFractalRect().width());
+    if (budget == m_maxIterations)
+        return false;
+
+    // pixels kept from the previous view were calculated with the old budget: a bigger budget might still see the
+    // interior ones escape, and a smaller one turns the ones that took too long into interior points
+    for (auto &value : m_iterations)
+        if (budget > m_maxIterations ? value == 0 : static_cast<int>(value) > budget)
+            value = Palette::notCalculated;
+
+    m_maxIterations = budget;
+    emit maxIterationsChanged();
+    return true;
+}
+
+void FractalView::updatePrecision(const RenderJob &job)
+{
+    const unsigned digits = job.view.precision();
+    QString precision;
+    double cost = 0;
+    if (usesPerturbation(job.formula, job.deepZoom, job.precision))
+    {
+        // the pixels are offsets in double (or long double, past where double underflows; see ViewPerturbation) and
+        // only the reference orbit is in MPFR, once per render
+        const big_float spacing = job.view.width() / job.view.visualRect().width();
+        const auto offsets = needsExtendedOffsets(spacing) ? Precision::LongDouble : Precision::Double;
+        precision = QString{"%1, MPFR orbit with %2 digits"}.arg(precisionName(offsets)).arg(digits);
+        cost = ::precisionCost(offsets, digits);
+    }
+    else
+    {
+        precision = precisionName(job.precision);
+        if (job.precision == Precision::MultiPrecision)
+            precision += QString{", %1 digits"}.arg(digits);
+        cost = ::precisionCost(job.precision, digits);
+    }
+
+    if (precision == m_precision && cost == m_precisionCost)
+        return;
+    m_precision = precision;
+    m_precisionCost = cost;
+    emit precisionChanged();
+}
+
+void FractalView::recolor()
+{
+    if (m_image.isNull())
+        return;
+
+    // recoloring is just a table lookup per pixel, so hand out bands of rows to all the cores and be done in a few ms
+    constexpr int bandHeight = 32;
+    QVector<int> bands;
+    for (int row = 0; row < m_image.height(); row += bandHeight)
+        bands.push_back(row);
+
+    const auto palette = std::atomic_load(&m_palette);
+    auto pixels = m_image.bits();
+    const auto bytesPerLine = m_image.bytesPerLine();
+    const auto imageWidth = m_image.width();
+    const auto imageHeight = m_image.height();
+    QtConcurrent::blockingMap(bands, [&](int firstRow) {
+        for (int row = firstRow; row < std::min(firstRow + bandHeight, imageHeight); ++row)
+            palette->colorize(m_iterations.data() + static_cast<size_t>(row) * imageWidth,
+                              reinterpret_cast<QRgb *>(pixels + row * bytesPerLine), imageWidth);
+    });
+    markAllDirty();
+}
+
+void FractalView::updateFocus()
+{
+    if (m_job)
+        m_job->scheduler.setFocus(QPointF{m_image.width() / 2.0 + m_xOffset, m_image.height() / 2.0 + m_yOffset});
 }
 
 void FractalView::saveImage(QString filename)
 {
-    m_imageMutex.lock();
-    m_image.save(QUrl{filename}.toLocalFile());
-    m_imageMutex.unlock();
+    if (m_isSaving)
+        return;
+
+    // supersampling a deep view takes a while, so the export runs in the background on copies of everything it needs,
+    // and the view is free to go on (and start rendering again) in the meantime. The copies are taken like cancelRender()
+    // cancels, so no worker is halfway through a row of them.
+    QImage image;
+    std::vector<float> iterations;
+    // the supersampler works out extra escape-time samples, which have nothing to do with an orbit density
+    const bool antialias = m_exportSamples > 1 && !m_isLoading && !drawsDensity(m_renderMode, m_type);
+    {
+        QWriteLocker locker{&m_frameLock};
+        image = m_image.copy();
+        if (antialias)
+            iterations = m_iterations;
+    }
+
+    Supersampler::Settings settings;
+    settings.formula = m_type;
+    settings.juliaConstant = m_juliaPos;
+    settings.maxIterations = m_maxIterations;
+    settings.deepZoom = m_deepZoom;
+    settings.samples = m_exportSamples;
+    const FractalRect view = getCurrentFractalRect();
+    const auto palette = std::atomic_load(&m_palette);
+    const QString path = QUrl{filename}.toLocalFile();
+
+    m_isSaving = true;
+    emit isSavingChanged();
+    // the destructor waits for these along with the renders
+    m_renders.push_back(QtConcurrent::run([this, image, iterations = std::move(iterations), antialias, view, settings, palette,
+                                           path]() mutable {
+        if (antialias)
+            Supersampler{view, settings}.antialias(iterations.data(), *palette, image);
+        image.save(path);
+        QMetaObject::invokeMethod(this, [this] { m_isSaving = false; emit isSavingChanged(); }, Qt::QueuedConnection);
+    }));
+}
+
+bool FractalView::saveTrace(QString filename)
+{
+    return m_lastTelemetry && m_lastTelemetry->writeTrace(QUrl{filename}.toLocalFile());
 }
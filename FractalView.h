@@ -1,52 +1,139 @@
 #ifndef FRACTALVIEW_H
 #define FRACTALVIEW_H
 
-#include <QQuickPaintedItem>
+#include <QQuickItem>
 #include <QImage>
-#include <QMutex>
+#include <QFuture>
+#include <QReadWriteLock>
+#include <QVariantList>
 
+#include <atomic>
 #include <complex>
+#include <memory>
+#include <vector>
 
+#include "Buddhabrot.h"
 #include "Common.h"
 #include "FractalRect.h"
+#include "Kernels.h"
+#include "Mirror.h"
+#include "Palette.h"
+#include "Perturbation.h"
+#include "RenderTelemetry.h"
+#include "TileCache.h"
+#include "TileScheduler.h"
 
-class FractalView : public QQuickPaintedItem
+class FractalView : public QQuickItem
 {
     Q_OBJECT
 
     Q_PROPERTY(bool isLoading READ isLoading NOTIFY isLoadingChanged)
-    Q_PROPERTY(Type type READ type WRITE setType NOTIFY typeChanged)
+    // the formula on display, as an index into formulas
+    Q_PROPERTY(int type READ type WRITE setType NOTIFY typeChanged)
+    // every formula there is, each as a map with the name fracture-render knows it by and a label to show for it
+    Q_PROPERTY(QVariantList formulas READ formulas CONSTANT)
+    // where the Julia constant got picked on the Mandelbrot set's view
     Q_PROPERTY(QPoint juliaPoint READ juliaPoint WRITE setJuliaPoint NOTIFY juliaPointChanged)
     Q_PROPERTY(double zoomFactor READ zoomFactor WRITE setZoomFactor RESET resetZoomFactor NOTIFY zoomFactorChanged)
     Q_PROPERTY(double xOffset READ xOffset WRITE setXOffset RESET resetXOffset NOTIFY xOffsetChanged)
     Q_PROPERTY(double yOffset READ yOffset WRITE setYOffset RESET resetYOffset NOTIFY yOffsetChanged)
+    Q_PROPERTY(bool deepZoom READ deepZoom WRITE setDeepZoom NOTIFY deepZoomChanged)
+    // what the latest render calculates in, e.g. "MPFR, 64 digits", and roughly how many times as long each iteration
+    // takes as one in double; both grow as the view zooms in
+    Q_PROPERTY(QString precision READ precision NOTIFY precisionChanged)
+    Q_PROPERTY(double precisionCost READ precisionCost NOTIFY precisionChanged)
+    Q_PROPERTY(ColorScheme colorScheme READ colorScheme WRITE setColorScheme NOTIFY colorSchemeChanged)
+    Q_PROPERTY(bool smoothColoring READ smoothColoring WRITE setSmoothColoring NOTIFY smoothColoringChanged)
+    Q_PROPERTY(int maxIterations READ maxIterations WRITE setMaxIterations NOTIFY maxIterationsChanged)
+    Q_PROPERTY(bool autoIterations READ autoIterations WRITE setAutoIterations NOTIFY autoIterationsChanged)
+    Q_PROPERTY(RenderMode renderMode READ renderMode WRITE setRenderMode NOTIFY renderModeChanged)
+    Q_PROPERTY(bool verifyFill READ verifyFill WRITE setVerifyFill NOTIFY verifyFillChanged)
+    Q_PROPERTY(int fillMismatches READ fillMismatches NOTIFY fillMismatchesChanged)
+    // the most samples a pixel of a saved image gets; only pixels on an edge get more than one, see Supersampler
+    Q_PROPERTY(int exportSamples READ exportSamples WRITE setExportSamples NOTIFY exportSamplesChanged)
+    // an image is being supersampled and written in the background; saveImage() does nothing until that's done
+    Q_PROPERTY(bool isSaving READ isSaving NOTIFY isSavingChanged)
+    // render telemetry: per-tile timings for saveTrace(), and these stats of the latest render for an overlay
+    Q_PROPERTY(bool telemetry READ telemetry WRITE setTelemetry NOTIFY telemetryChanged)
+    Q_PROPERTY(double frameMilliseconds READ frameMilliseconds NOTIFY frameStatsChanged)
+    Q_PROPERTY(double megapixelsPerSecond READ megapixelsPerSecond NOTIFY frameStatsChanged)
+    Q_PROPERTY(double gigaiterationsPerSecond READ gigaiterationsPerSecond NOTIFY frameStatsChanged)
+    // the orbits the Buddhabrot modes go through; 0 for the escape-time ones
+    Q_PROPERTY(double megasamplesPerSecond READ megasamplesPerSecond NOTIFY frameStatsChanged)
+    Q_PROPERTY(double threadUtilization READ threadUtilization NOTIFY frameStatsChanged)
 
 public:
-    enum Type
+    // these mirror Palette::Scheme
+    enum ColorScheme
     {
-        Mandelbrot,
-        Julia,
-        BurningShip,
+        Classic = Palette::Classic,
+        Fire = Palette::Fire,
+        Ocean = Palette::Ocean,
+        Grayscale = Palette::Grayscale,
     };
-    Q_ENUM(Type)
+    Q_ENUM(ColorScheme)
+
+    enum RenderMode
+    {
+        // calculate every pixel, in coarse-to-fine passes
+        BruteForce,
+        // only calculate the outlines of rectangles and fill in the ones whose outline has a single iteration count
+        MarianiSilver,
+        // draw how densely the orbits that escape pass through every pixel instead, see Buddhabrot.h; Newton's fractal
+        // has no escaping orbits and sticks to brute force
+        Buddhabrot,
+        // the same for the orbits that never escape
+        AntiBuddhabrot,
+    };
+    Q_ENUM(RenderMode)
 
     explicit FractalView(QQuickItem *parent = nullptr);
     ~FractalView();
 
-    virtual void paint(QPainter *painter);
-
     bool isLoading() const { return m_isLoading; }
-    Type type() const { return m_type; }
+    int type() const { return static_cast<int>(m_type); }
+    QVariantList formulas() const;
+    // the index of the formula called name, or -1 if there is none
+    Q_INVOKABLE int formulaIndex(const QString &name) const;
+    // the point of the plane at position in the view, in double; enough for a preview, see JuliaPreview
+    Q_INVOKABLE QPointF fractalPoint(QPointF position);
     QPoint juliaPoint() const { return m_juliaPoint; }
     double zoomFactor() const { return m_zoomFactor; }
     double xOffset() const { return m_xOffset; }
     double yOffset() const { return m_yOffset; }
+    bool deepZoom() const { return m_deepZoom; }
+    QString precision() const { return m_precision; }
+    double precisionCost() const { return m_precisionCost; }
+    ColorScheme colorScheme() const { return m_colorScheme; }
+    bool smoothColoring() const { return m_smoothColoring; }
+    int maxIterations() const { return m_maxIterations; }
+    bool autoIterations() const { return m_autoIterations; }
+    RenderMode renderMode() const { return m_renderMode; }
+    bool verifyFill() const { return m_verifyFill; }
+    int fillMismatches() const { return m_fillMismatches; }
+    int exportSamples() const { return m_exportSamples; }
+    bool isSaving() const { return m_isSaving; }
+    bool telemetry() const { return m_telemetry; }
+    double frameMilliseconds() const { return m_frameStats.milliseconds; }
+    double megapixelsPerSecond() const;
+    double gigaiterationsPerSecond() const;
+    double megasamplesPerSecond() const;
+    double threadUtilization() const { return m_frameStats.utilization; }
 
-    void setType(Type type);
+    void setType(int type);
     void setJuliaPoint(QPoint point);
     void setZoomFactor(double factor);
     void setXOffset(double offset);
     void setYOffset(double offset);
+    void setDeepZoom(bool deepZoom);
+    void setColorScheme(ColorScheme scheme);
+    void setSmoothColoring(bool smooth);
+    void setMaxIterations(int iterations);
+    void setAutoIterations(bool autoIterations);
+    void setRenderMode(RenderMode mode);
+    void setVerifyFill(bool verify);
+    void setExportSamples(int samples);
+    void setTelemetry(bool telemetry);
 
     void resetNavigationRect();
     void resetZoomFactor();
@@ -54,7 +141,8 @@ public:
     void resetYOffset();
 
 signals:
-    // since we want to call update() from the render thread(s), this signal is needed to get the call working properly
+    // since we want to call update() from the render thread(s), this signal is needed to get the call working properly;
+    // the workers only emit it through markDirty(), which keeps it down to one per frame
     void updateView();
 
     void isLoadingChanged();
@@ -64,6 +152,19 @@ signals:
     void zoomFactorChanged();
     void xOffsetChanged();
     void yOffsetChanged();
+    void deepZoomChanged();
+    void precisionChanged();
+    void colorSchemeChanged();
+    void smoothColoringChanged();
+    void maxIterationsChanged();
+    void autoIterationsChanged();
+    void renderModeChanged();
+    void verifyFillChanged();
+    void fillMismatchesChanged();
+    void exportSamplesChanged();
+    void isSavingChanged();
+    void telemetryChanged();
+    void frameStatsChanged();
 
 public slots:
     void cancelRender();
@@ -71,17 +172,175 @@ public slots:
 
     void applyZoomIn();
     void applyZoomOut();
+    // moves the view by a number of pixels, keeping everything that is still visible
+    void pan(int dx, int dy);
 
     void saveImage(QString filename);
+    // writes the telemetry of the latest render as a Chrome trace; returns false if there is none or it can't be written
+    bool saveTrace(QString filename);
+
+protected:
+    // starts a render if the view needs one; this runs on the GUI thread before every frame the view asked for
+    void updatePolish() override;
+    // puts the image on screen as a grid of textures, uploading only the tiles that changed since the last frame. This
+    // runs on the scene graph's render thread, while the GUI thread is blocked.
+    QSGNode *updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *data) override;
 
 private:
+    // Which tiles of the image changed since the scene graph last uploaded them. The workers mark the tiles they write
+    // to, and the GUI thread marks everything whenever it replaces or recolors the whole image.
+    struct DirtyTiles
+    {
+        explicit DirtyTiles(QSize imageSize);
+
+        // the part of the image that tile index covers
+        QRect tileRect(int index) const;
+        int tileCount() const { return columns * rows; }
+        void mark(const QRect &area);
+        void markAll();
+        // clears the tile's mark and returns whether it had one
+        bool take(int index);
+
+        QSize imageSize;
+        int columns;
+        int rows;
+        std::unique_ptr<std::atomic<bool>[]> flags;
+    };
+
     FractalRect &getCurrentFractalRect();
 
+    void resizeImage();
+    // forgets every pixel, so the next render starts from scratch
+    void clearPixels();
+    // carries the pixels over from the view in from to the one in to: pixels that sit exactly on one of the old pixels
+    // keep its iteration count, and the rest get a stretched copy of the old image as a preview until they're rendered
+    void remapPixels(const FractalRect &from, const FractalRect &to);
+    void updatePalette();
+    // in auto mode, moves the iteration budget along with the zoom depth; returns true if it changed
+    bool updateAutoIterations();
+    // recolors every pixel that has been calculated so far from the iteration buffer
+    void recolor();
+    // points the tile scheduler at the middle of the zoom box
+    void updateFocus();
+    // flags everything in the image as changed and asks for a frame
+    void markAllDirty();
+
+    // Everything a render needs, copied from the members when it starts. The workers only ever look at their job, so
+    // the GUI thread is free to change settings (or start another render) while they're still winding down.
+    struct RenderJob
+    {
+        int generation{0};
+        // set once this job's generation is no longer the current one; the workers and kernels poll it
+        std::atomic<bool> cancelled{false};
+        FractalRect view;
+        Formula formula{Formula::Mandelbrot};
+        complex juliaPos;
+        int maxIterations{defaultMaxIterations};
+        RenderMode renderMode{RenderMode::BruteForce};
+        bool verifyFill{false};
+        bool hasPreview{false};
+        bool deepZoom{true};
+        Precision precision{Precision::Double};
+        // the palette the render started out with
+        std::shared_ptr<const Palette> palette;
+        // the frame the job renders into; only valid while cancelled isn't set, see m_frameLock
+        uchar *pixels{nullptr};
+        qsizetype bytesPerLine{0};
+        float *iterations{nullptr};
+        int width{0};
+        int height{0};
+        std::atomic<int> fillMismatches{0};
+        // the tiles around the zoom box get rendered first, since that's where the user is looking
+        TileScheduler scheduler;
+        // null unless telemetry is on
+        std::shared_ptr<RenderTelemetry> telemetry;
+        // the frame's dirty tiles; the view replaces its own when the frame changes size, and this one stays valid
+        std::shared_ptr<DirtyTiles> dirtyTiles;
+    };
+
+    // flags area of job's frame as changed, and asks for a frame unless one is on its way already; called by the
+    // workers after they've written to the frame
+    void markDirty(RenderJob &job, const QRect &area);
+
+    // called on the GUI thread once every tile of job is done
+    void finishRender(const std::shared_ptr<RenderJob> &job);
+    // publishes the stats of job's telemetry, if it's still the current render
+    void updateFrameStats(const std::shared_ptr<RenderJob> &job);
+    // shows what job calculates in
+    void updatePrecision(const RenderJob &job);
+
+    // whether mode draws formula as an orbit density rather than by escape time
+    static bool drawsDensity(RenderMode mode, Formula formula);
+    // the whole of a density render: batches of ever more orbits, with the image tone mapped from all of them so far
+    // after every one
+    void renderDensity(const std::shared_ptr<RenderJob> &job);
+
+    // everything that decides what ends up in a tile of job
+    static TileCache::Key cacheKey(const RenderJob &job, const QRect &tile);
+    // fills tile in from the tile cache, if it's in there, and returns whether it was
+    bool loadCachedTile(RenderJob &job, const QRect &tile, int blockSize);
+    // hands tile to the tile cache once every one of its pixels is done
+    void storeCachedTile(RenderJob &job, const QRect &tile);
+    // fills in the pixels of tiles, which mirror others, from the pixels they mirror; once the last pass is finished
+    // they go into the tile cache as well
+    void mirrorTiles(RenderJob &job, const Mirror &mirror, const QVector<QRect> &tiles, bool finished);
+
+    // renders the part of one progressive pass that falls into tile: the pixels on a grid of blockSize that haven't
+    // been calculated yet, each stretched over its block until a finer pass fills in the rest. calculate is called once
+    // per row with the row index and a list of columns and fills in the smoothed iteration counts of those pixels; it
+    // returns false if the render got cancelled while it was working
+    template<typename Calculator>
+    void renderFragment(RenderJob &job, const QRect &tile, int blockSize, const Calculator &calculate);
+    // does the actual work of renderFragment(), which wraps it to time and count the tile when telemetry is on
+    template<typename Calculator>
+    void renderTile(RenderJob &job, const QRect &tile, int blockSize, const Calculator &calculate);
+    // calculates the pixels of a row that are columnStep apart and haven't been calculated yet into the iteration
+    // buffer and colors them; returns false if the render got cancelled
+    template<typename Calculator>
+    bool calculateRun(RenderJob &job, int row, int firstColumn, int columnStep, int count, const Calculator &calculate,
+                      std::vector<int> &columns, std::vector<float> &scratch);
+    // the Mariani-Silver algorithm: the outline of the rectangle from left/top up to right/bottom has been calculated
+    // already; if all of it escaped at the same iteration, the inside gets filled in without calculating it, otherwise
+    // the rectangle is cut in two and both halves get traced the same way. Returns false if the render got cancelled.
+    template<typename Calculator>
+    bool traceRect(RenderJob &job, int left, int top, int right, int bottom, const Calculator &calculate, std::vector<int> &columns,
+                   std::vector<float> &scratch);
+    template<typename Calculator>
+    bool fillRect(RenderJob &job, int left, int top, int right, int bottom, const Calculator &calculate, std::vector<int> &columns,
+                  std::vector<float> &scratch);
+    template<typename T>
+    void renderDirectFragment(RenderJob &job, const QRect &tile, int blockSize);
+    template<typename D>
+    void renderPerturbedFragment(RenderJob &job, const QRect &tile, int blockSize, const Perturbation<D> &perturbation,
+                                 const QPointF &referencePixel, const D &spacing);
+
     QImage m_image;
+    // the smoothed iteration count of every pixel in m_image (or for the density modes, its tone mapped hit count), so
+    // that changing the coloring never needs a recompute
+    std::vector<float> m_iterations;
+    // the image holds a stretched copy of the previous view, which makes a better preview than the coarse passes' blocks
+    bool m_hasPreview{false};
+    // the workers pick up the current palette for every row they color, so this gets swapped atomically
+    std::shared_ptr<const Palette> m_palette;
+    ColorScheme m_colorScheme{ColorScheme::Classic};
+    bool m_smoothColoring{true};
+    int m_maxIterations{defaultMaxIterations};
+    bool m_autoIterations{true};
+    RenderMode m_renderMode{RenderMode::BruteForce};
+    // calculate the filled in pixels anyway and count how many of them the fill got wrong
+    bool m_verifyFill{false};
+    int m_fillMismatches{0};
+    int m_exportSamples{16};
+    bool m_isSaving{false};
+    bool m_telemetry{false};
+    RenderTelemetry::Summary m_frameStats;
+    // the telemetry of the latest render that got to finish, for saveTrace()
+    std::shared_ptr<RenderTelemetry> m_lastTelemetry;
     bool m_isFullyLoaded{false};
     bool m_isLoading{false};
-    Type m_type{Type::Mandelbrot};
-    QMap<Type, FractalRect> m_fractalRects;
+    Formula m_type{Formula::Mandelbrot};
+    // the view of every formula, in the order of the Formula enum
+    std::vector<FractalRect> m_fractalRects;
 
     // this is a pretty nice default value; let's use it for now
     complex m_juliaPos{0.63982341, 0.123432153};
@@ -97,10 +356,31 @@ private:
     double m_xOffset{0};
     double m_yOffset{0};
 
-    QMutex m_imageMutex;
-    QMutex m_remainingFragmentsMutex;
-    int m_remainingFragments;
-    bool m_cancelRenderRequested{false};
+    // use perturbation theory instead of software floats once a view needs more precision than long double
+    bool m_deepZoom{true};
+    QString m_precision{precisionName(Precision::Double)};
+    double m_precisionCost{1};
+
+    std::shared_ptr<DirtyTiles> m_dirtyTiles;
+    // set from the first tile marked dirty until the next frame picks it up, so the workers don't flood the GUI thread
+    // with updates that would all end up in the same frame anyway
+    std::atomic<bool> m_updatePending{false};
+    // the image size the scene graph's tile nodes were laid out for; only touched while the scene graph syncs
+    QSize m_sceneImageSize;
+
+    // Workers hold this for reading while they touch m_image or m_iterations, and only after checking that their job
+    // hasn't been cancelled; cancelRender() holds it for writing while it cancels. Once that returns, no worker of an
+    // old job will touch the frame again, so the GUI thread can swap it out without waiting for the workers to finish.
+    // Copying pixels out of the frame for the screen or for saving holds it for writing as well.
+    QReadWriteLock m_frameLock;
+    // every render gets the next generation; anything tagged with an older one is stale
+    std::atomic<int> m_generation{0};
+    // the render that is currently running, if any
+    std::shared_ptr<RenderJob> m_job;
+    // render threads that might still be running, including cancelled ones; the destructor has to wait for them
+    QVector<QFuture<void>> m_renders;
+    // finished tiles of every view we've rendered, in memory and on disk
+    TileCache m_tileCache;
 };
 
 #endif // FRACTALVIEW_H
@@ -0,0 +1,166 @@
+#include "JuliaPreview.h"
+
+#include <QElapsedTimer>
+#include <QQuickWindow>
+#include <QSGSimpleTextureNode>
+
+#include <algorithm>
+#include <vector>
+
+#include "Formulas.h"
+#include "Kernels.h"
+#include "SimdKernels.h"
+
+namespace
+{
+// how long a render may take before the next one gets fewer iterations; half of a frame at 60 Hz, which leaves the
+// other half for getting it on screen
+constexpr qint64 frameBudget = 8'000'000;
+// the iteration budget stays within these; past the upper one the preview is too small to show the difference
+constexpr int minimumIterations = 32;
+constexpr int maximumIterations = 1024;
+constexpr int initialIterations = 256;
+
+// the preview's texture, which the node owns and deletes when it gets replaced
+class PreviewNode : public QSGSimpleTextureNode
+{
+public:
+    ~PreviewNode() override { delete texture(); }
+
+    void replaceTexture(QSGTexture *texture)
+    {
+        QSGTexture *old = this->texture();
+        setTexture(texture);
+        delete old;
+    }
+};
+}
+
+JuliaPreview::JuliaPreview(QQuickItem *parent)
+    : QQuickItem{parent},
+      m_maxIterations{initialIterations}
+{
+    setFlag(ItemHasContents);
+    m_pool.setMaxThreadCount(1);
+    connect(this, &QQuickItem::widthChanged, this, &JuliaPreview::render);
+    connect(this, &QQuickItem::heightChanged, this, &JuliaPreview::render);
+}
+
+JuliaPreview::~JuliaPreview()
+{
+    if (m_job)
+        m_job->cancelled = true;
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+void JuliaPreview::setConstant(QPointF constant)
+{
+    if (constant == m_constant)
+        return;
+
+    m_constant = constant;
+    emit constantChanged();
+    render();
+}
+
+void JuliaPreview::setColorScheme(int scheme)
+{
+    if (scheme == m_colorScheme)
+        return;
+
+    m_colorScheme = scheme;
+    emit colorSchemeChanged();
+    render();
+}
+
+QSGNode *JuliaPreview::updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *)
+{
+    if (m_image.isNull())
+    {
+        delete oldNode;
+        return nullptr;
+    }
+
+    auto node = oldNode ? static_cast<PreviewNode *>(oldNode) : new PreviewNode;
+    if (m_imageChanged || !node->texture())
+    {
+        node->replaceTexture(window()->createTextureFromImage(m_image));
+        m_imageChanged = false;
+    }
+    node->setRect(boundingRect());
+    return node;
+}
+
+void JuliaPreview::render()
+{
+    // a stale render would only hold up the current one, so it stops at its next row, and one that hasn't even
+    // started never does
+    if (m_job)
+        m_job->cancelled = true;
+    m_job.reset();
+    m_pool.clear();
+
+    const QSize size = boundingRect().size().toSize();
+    if (size.isEmpty())
+        return;
+
+    auto job = std::make_shared<RenderJob>();
+    job->constant = m_constant;
+    job->size = size;
+    job->maxIterations = m_maxIterations;
+    job->palette = std::make_shared<Palette>(static_cast<Palette::Scheme>(m_colorScheme), m_maxIterations);
+    m_job = job;
+
+    m_pool.start([this, job] {
+        QElapsedTimer timer;
+        timer.start();
+
+        // the Julia set's initial view, fit into the preview without stretching it
+        const auto &region = formulaInfo(Formula::Julia).initialView;
+        const int width = job->size.width();
+        const int height = job->size.height();
+        const double spacing = std::max(region.width / width, region.height / height);
+        const double left = region.left + (region.width - spacing * (width - 1)) / 2;
+        const double top = region.top + (region.height - spacing * (height - 1)) / 2;
+        const double tolerance = periodTolerance(spacing);
+
+        QImage image{job->size, QImage::Format_ARGB32};
+        std::vector<double> reals(static_cast<size_t>(width));
+        std::vector<double> imags(static_cast<size_t>(width));
+        std::vector<float> values(static_cast<size_t>(width));
+        for (int i = 0; i < width; ++i)
+            reals[static_cast<size_t>(i)] = left + i * spacing;
+        for (int j = 0; j < height; ++j)
+        {
+            if (job->cancelled)
+                return;
+            std::fill(imags.begin(), imags.end(), top + j * spacing);
+            calculatePoints(Formula::Julia, reals.data(), imags.data(), job->constant.x(), job->constant.y(), job->maxIterations,
+                            tolerance, width, values.data(), &job->cancelled);
+            job->palette->colorize(values.data(), reinterpret_cast<QRgb *>(image.scanLine(j)), width);
+        }
+        if (job->cancelled)
+            return;
+
+        const qint64 nanoseconds = timer.nsecsElapsed();
+        QMetaObject::invokeMethod(this, [this, job, image, nanoseconds] { finishRender(job, image, nanoseconds); }, Qt::QueuedConnection);
+    });
+}
+
+void JuliaPreview::finishRender(const std::shared_ptr<RenderJob> &job, const QImage &image, qint64 nanoseconds)
+{
+    if (job != m_job)
+        return;
+
+    m_job.reset();
+    m_image = image;
+    m_imageChanged = true;
+    update();
+
+    // the next render gets a budget that fits this one's timing; the constants near the cursor take about as long
+    if (nanoseconds > frameBudget)
+        m_maxIterations = std::max(m_maxIterations / 2, minimumIterations);
+    else if (nanoseconds * 4 < frameBudget)
+        m_maxIterations = std::min(m_maxIterations * 2, maximumIterations);
+}
@@ -0,0 +1,76 @@
+#ifndef JULIAPREVIEW_H
+#define JULIAPREVIEW_H
+
+#include <QQuickItem>
+#include <QImage>
+#include <QPointF>
+#include <QSize>
+#include <QThreadPool>
+
+#include <atomic>
+#include <memory>
+
+#include "Palette.h"
+
+// A small Julia set for whatever constant the cursor is over, for picking one on the Mandelbrot set without rendering
+// each candidate in full. Every new constant cancels the render of the previous one, which never gets shown, so the
+// preview keeps up with the cursor instead of working through a backlog of stale ones.
+//
+// The renders are in double with the vector kernels, and keep to an iteration budget that fits one well inside a
+// frame: it halves whenever a render runs over, and doubles again whenever one comes in far under.
+class JuliaPreview : public QQuickItem
+{
+    Q_OBJECT
+
+    // the Julia constant on display
+    Q_PROPERTY(QPointF constant READ constant WRITE setConstant NOTIFY constantChanged)
+    // one of FractalView.ColorScheme
+    Q_PROPERTY(int colorScheme READ colorScheme WRITE setColorScheme NOTIFY colorSchemeChanged)
+
+public:
+    explicit JuliaPreview(QQuickItem *parent = nullptr);
+    ~JuliaPreview();
+
+    QPointF constant() const { return m_constant; }
+    int colorScheme() const { return m_colorScheme; }
+
+    void setConstant(QPointF constant);
+    void setColorScheme(int scheme);
+
+signals:
+    void constantChanged();
+    void colorSchemeChanged();
+
+protected:
+    QSGNode *updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *data) override;
+
+private:
+    // everything a render needs, copied from the members when it starts, like FractalView::RenderJob
+    struct RenderJob
+    {
+        // set once a newer render started; the kernels poll it
+        std::atomic<bool> cancelled{false};
+        QPointF constant;
+        QSize size;
+        int maxIterations{0};
+        std::shared_ptr<const Palette> palette;
+    };
+
+    // starts rendering the current constant, and cancels whatever render was running
+    void render();
+    // called on the GUI thread once job got to finish
+    void finishRender(const std::shared_ptr<RenderJob> &job, const QImage &image, qint64 nanoseconds);
+
+    QPointF m_constant;
+    int m_colorScheme{Palette::Classic};
+    int m_maxIterations;
+    QImage m_image;
+    // the image changed since the scene graph last uploaded it
+    bool m_imageChanged{false};
+    // the render that is currently running, if any
+    std::shared_ptr<RenderJob> m_job;
+    // a thread of its own, so the preview never waits behind the tiles of a render of the main view
+    QThreadPool m_pool;
+};
+
+#endif // JULIAPREVIEW_H
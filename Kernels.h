@@ -0,0 +1,339 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "Common.h"
+
+// the iteration kernels are templated on their scalar type so that shallow views can run on plain hardware floats and
+// only really deep zooms have to pay for MPFR; see FractalRect::requiredPrecision() for how the type is picked
+
+template<typename T>
+T scalar_cast(const big_float &value)
+{
+    return value.convert_to<T>();
+}
+
+template<>
+inline big_float scalar_cast<big_float>(const big_float &value)
+{
+    return value;
+}
+
+#ifdef FRACTURE_HAS_FLOAT128
+template<>
+inline __float128 scalar_cast<__float128>(const big_float &value)
+{
+    // MPFR can't always hand us a __float128 directly, so we split the value into two long doubles; between them they
+    // carry more than the 113 bits a __float128 can hold
+    const long double high = value.convert_to<long double>();
+    const long double low = big_float{value - high}.convert_to<long double>();
+    return static_cast<__float128>(high) + low;
+}
+#endif
+
+// how many iterations a point gets before we decide it's part of the set, unless told otherwise
+constexpr int defaultMaxIterations = 100;
+
+// The closer we get to the boundary of the set, the longer the orbits take to make up their minds, so every time the
+// view halves in size the budget grows by a bit; the full views are 4 units wide.
+inline int autoIterationBudget(const big_float &viewWidth)
+{
+    const double doublings = boost::multiprecision::log(big_float{4 / viewWidth}).convert_to<double>() / std::log(2.0);
+    return defaultMaxIterations + static_cast<int>(std::max(doublings, 0.0) * 50);
+}
+
+// How many iterations a pixel was worth, going by its smoothed iteration count: the ones it took to escape, or the whole
+// budget for interior points, since that's what they'd cost without the cardioid and periodicity shortcuts. That way a
+// faster shortcut shows up as more iterations per second rather than as less work.
+inline std::int64_t iterationsSpent(float value, int maxIterations)
+{
+    return value == 0 ? maxIterations : static_cast<std::int64_t>(value);
+}
+
+// A render can be cancelled from the GUI thread at any time, so the kernels take an optional flag and give up on the
+// point (returning 0) once it's set. Checking it every iteration would cost a load per step; every cancelCheckInterval
+// iterations is still often enough for even an MPFR orbit to notice within a few milliseconds.
+constexpr int cancelCheckInterval = 1024;
+
+inline bool isCancelled(const std::atomic<bool> *cancelled, int iteration)
+{
+    return cancelled && iteration % cancelCheckInterval == 0 && cancelled->load(std::memory_order_relaxed);
+}
+
+// A cheap log2 for positive, finite values that is accurate to about 2e-4, which is plenty for coloring and a lot
+// faster than std::log2: the exponent comes straight from the float's bits and the mantissa goes through a
+// polynomial fitted to log2 on [1, 2).
+inline float fastLog2(float value)
+{
+    std::uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    const float exponent = static_cast<int>((bits >> 23) & 0xff) - 127;
+    bits = (bits & 0x7fffff) | 0x3f800000;
+    float mantissa;
+    std::memcpy(&mantissa, &bits, sizeof(mantissa));
+
+    const float t = mantissa - 1.5f;
+    return exponent + 0.58495426f + t * (0.96116720f + t * (-0.31991806f + t * (0.15392465f + t * -0.07915816f)));
+}
+
+// Turns the iteration count an orbit escaped at, plus how far past the bailout it ended up (magnitude is |z|^2), into a
+// continuous value for smooth coloring. The integer part is always the plain iteration count; the fraction goes from 1
+// for orbits that only just crossed |z| = 2 down to 0 for ones that overshot to |z| = 4, or to 2^degree for formulas
+// that raise z to a higher power than 2.
+inline float smoothIterations(int iterations, double magnitude, int degree = 2)
+{
+    float overshoot = fastLog2(fastLog2(static_cast<float>(magnitude)) / 2);
+    if (degree != 2)
+        overshoot /= std::log2(static_cast<float>(degree));
+    const float fraction = 1 - overshoot;
+    // clamp to just below the next integer in float terms, which gets coarser as the iteration counts get bigger
+    const float ceiling = std::nextafter(static_cast<float>(iterations + 1), 0.0f);
+    return std::min(iterations + std::max(fraction, 0.0f), ceiling);
+}
+
+// The tolerance PeriodicityCheck gets for pixels spacing apart: orbits that come back to within a small fraction of a
+// pixel of an earlier value are taken as periodic. Every renderer goes through this, so they all agree on which pixels
+// are inside.
+template<typename T>
+T periodTolerance(const T &spacing)
+{
+    return (spacing / 8192) * (spacing / 8192);
+}
+
+// Brent-style cycle detection: z is compared against a saved value, and a new value is saved after 1, 2, 4, 8, ...
+// iterations. Points inside the set settle into a cycle sooner or later, and once z comes back to within the tolerance
+// (a squared distance) of an earlier value we know it's never going to escape. A tolerance of 0 turns the check off.
+template<typename T>
+class PeriodicityCheck
+{
+public:
+    PeriodicityCheck(const T &real, const T &imag, const T &tolerance)
+        : m_real{real},
+          m_imag{imag},
+          m_tolerance{tolerance}
+    {}
+
+    bool isPeriodic(const T &real, const T &imag)
+    {
+        const T realDistance = real - m_real;
+        const T imagDistance = imag - m_imag;
+        if (realDistance * realDistance + imagDistance * imagDistance < m_tolerance)
+            return true;
+
+        if (++m_steps == m_period)
+        {
+            m_real = real;
+            m_imag = imag;
+            m_steps = 0;
+            m_period *= 2;
+        }
+        return false;
+    }
+
+private:
+    T m_real;
+    T m_imag;
+    T m_tolerance;
+    int m_steps{0};
+    int m_period{1};
+};
+
+// the main cardioid and the period 2 bulb make up most of the Mandelbrot set's area, and there is a closed form test
+// for both of them; see <https://en.wikipedia.org/wiki/Plotting_algorithms_for_the_Mandelbrot_set#Cardioid_/_bulb_checking>
+template<typename T>
+bool isInMainCardioidOrBulb(const T &cReal, const T &cImag)
+{
+    const T imag2 = cImag * cImag;
+    const T shifted = cReal - 0.25;
+    const T q = shifted * shifted + imag2;
+    if (q * (q + shifted) <= imag2 * 0.25)
+        return true;
+
+    const T bulb = cReal + 1;
+    return bulb * bulb + imag2 <= 0.0625;
+}
+
+// All the kernels return 0 for points that never escape, and otherwise the smoothed iteration count they escaped at.
+// The result of a kernel that noticed cancelled being set is meaningless and should be thrown away.
+
+// folds value onto the positive half of its axis, in place so that MPFR doesn't need a temporary for it
+template<typename T>
+void makeNonNegative(T &value)
+{
+    if (value < 0)
+        value = -value;
+}
+
+inline void makeNonNegative(big_float &value)
+{
+    if (value < 0)
+        value.backend().negate();
+}
+
+// The loop every escape-time formula shares: iterates z = F::step(z, k) from the given z (after F::start() has had a
+// look at it) until |z| > 2, the periodicity check kicks in or the budget runs out. F is one of the formula types in
+// Formulas.h, whose step gets inlined right into the loop.
+//
+// the methodology of this loop comes from John R. H. Goering's
+// book `The Powers of the Square Root of -1` and also from
+// <https://warp.povusers.org/Mandelbrot>
+template<typename F, typename T>
+float iterateEscapeTime(T real, T imag, const T &kReal, const T &kImag, int maxIterations, const T &periodTolerance,
+                        const std::atomic<bool> *cancelled)
+{
+    F::start(real, imag);
+    T magnitude = real * real + imag * imag;
+    if (magnitude > 4)
+        return smoothIterations(1, static_cast<double>(magnitude), F::degree);
+
+    PeriodicityCheck<T> periodicity{real, imag, periodTolerance};
+    for (int i = 0; i < maxIterations; ++i)
+    {
+        if (isCancelled(cancelled, i))
+            return 0;
+
+        F::step(real, imag, kReal, kImag);
+        magnitude = real * real + imag * imag;
+        if (magnitude > 4)
+            return smoothIterations(i + 1, static_cast<double>(magnitude), F::degree);
+        if (periodicity.isPeriodic(real, imag))
+            return 0;
+    }
+    return 0;
+}
+
+// MPFR keeps its digits on the heap, so every temporary the generic kernels above create costs a malloc and a free,
+// which on deep views takes longer than the arithmetic itself. The overloads below (and the MPFR steps of the formulas)
+// do the same iterations in place on scratch values that every thread allocates once and then keeps reusing, so their
+// loops don't allocate at all.
+struct MultiPrecisionScratch
+{
+    // the scratch values of the calling thread, set to the given precision (in decimal digits)
+    static MultiPrecisionScratch &local(unsigned precision)
+    {
+        thread_local MultiPrecisionScratch scratch;
+        if (scratch.precision != precision)
+        {
+            for (big_float *value : {&scratch.real, &scratch.imag, &scratch.real2, &scratch.imag2, &scratch.magnitude, &scratch.savedReal,
+                                     &scratch.savedImag, &scratch.distance, &scratch.temp, &scratch.termReal, &scratch.termImag})
+                value->precision(precision);
+            scratch.precision = precision;
+        }
+        return scratch;
+    }
+
+    unsigned precision{0};
+    big_float real;
+    big_float imag;
+    // the squares of real and imag, which both the magnitude and the next iteration need
+    big_float real2;
+    big_float imag2;
+    big_float magnitude;
+    // what PeriodicityCheck keeps track of
+    big_float savedReal;
+    big_float savedImag;
+    big_float distance;
+    big_float temp;
+    // a complex intermediate for the steps that need more than the squares, like z^n for the Multibrot sets
+    big_float termReal;
+    big_float termImag;
+};
+
+// isInMainCardioidOrBulb(), worked out in scratch. Mixing in a double would need a temporary, so everything is scaled
+// by powers of two (which is exact) to get by with integers: with t = 4 * (cReal - 1/4) and u = t^2 + 16 * cImag^2,
+// the cardioid test becomes u * (u + 4 * t) <= 64 * cImag^2, and the bulb test 16 * ((cReal + 1)^2 + cImag^2) <= 1.
+inline bool isInMainCardioidOrBulb(MultiPrecisionScratch &scratch, const big_float &cReal, const big_float &cImag)
+{
+    using boost::multiprecision::add;
+    using boost::multiprecision::multiply;
+
+    multiply(scratch.imag2, cImag, cImag);
+    scratch.temp = cReal;
+    scratch.temp *= 4;
+    scratch.temp -= 1;
+    multiply(scratch.magnitude, scratch.temp, scratch.temp);
+    scratch.distance = scratch.imag2;
+    scratch.distance *= 16;
+    scratch.magnitude += scratch.distance;
+    scratch.temp *= 4;
+    add(scratch.distance, scratch.magnitude, scratch.temp);
+    scratch.distance *= scratch.magnitude;
+    scratch.temp = scratch.imag2;
+    scratch.temp *= 64;
+    if (scratch.distance <= scratch.temp)
+        return true;
+
+    scratch.temp = cReal;
+    scratch.temp += 1;
+    multiply(scratch.magnitude, scratch.temp, scratch.temp);
+    scratch.magnitude += scratch.imag2;
+    scratch.magnitude *= 16;
+    return scratch.magnitude <= 1;
+}
+
+inline bool isInMainCardioidOrBulb(const big_float &cReal, const big_float &cImag)
+{
+    return isInMainCardioidOrBulb(MultiPrecisionScratch::local(cReal.precision()), cReal, cImag);
+}
+
+// iterateEscapeTime() in scratch; F::step() gets the scratch values with real2 and imag2 holding the squares of the
+// current z and has to leave the next z in real and imag
+template<typename F>
+float iterateEscapeTime(const big_float &real, const big_float &imag, const big_float &kReal, const big_float &kImag, int maxIterations,
+                        const big_float &periodTolerance, const std::atomic<bool> *cancelled)
+{
+    using boost::multiprecision::add;
+    using boost::multiprecision::multiply;
+    using boost::multiprecision::subtract;
+
+    auto &scratch = MultiPrecisionScratch::local(real.precision());
+    scratch.real = real;
+    scratch.imag = imag;
+    F::start(scratch.real, scratch.imag);
+    multiply(scratch.real2, scratch.real, scratch.real);
+    multiply(scratch.imag2, scratch.imag, scratch.imag);
+    add(scratch.magnitude, scratch.real2, scratch.imag2);
+    if (scratch.magnitude > 4)
+        return smoothIterations(1, scratch.magnitude.convert_to<double>(), F::degree);
+
+    scratch.savedReal = scratch.real;
+    scratch.savedImag = scratch.imag;
+    int steps = 0;
+    int period = 1;
+    for (int i = 0; i < maxIterations; ++i)
+    {
+        if (isCancelled(cancelled, i))
+            return 0;
+
+        F::step(scratch, kReal, kImag);
+
+        multiply(scratch.real2, scratch.real, scratch.real);
+        multiply(scratch.imag2, scratch.imag, scratch.imag);
+        add(scratch.magnitude, scratch.real2, scratch.imag2);
+        if (scratch.magnitude > 4)
+            return smoothIterations(i + 1, scratch.magnitude.convert_to<double>(), F::degree);
+
+        subtract(scratch.distance, scratch.real, scratch.savedReal);
+        multiply(scratch.distance, scratch.distance, scratch.distance);
+        subtract(scratch.temp, scratch.imag, scratch.savedImag);
+        multiply(scratch.temp, scratch.temp, scratch.temp);
+        scratch.distance += scratch.temp;
+        if (scratch.distance < periodTolerance)
+            return 0;
+        if (++steps == period)
+        {
+            scratch.savedReal = scratch.real;
+            scratch.savedImag = scratch.imag;
+            steps = 0;
+            period *= 2;
+        }
+    }
+    return 0;
+}
+
+#endif // KERNELS_H
@@ -0,0 +1,59 @@
+#include "Mirror.h"
+
+#include <algorithm>
+
+namespace
+{
+// how far off a whole pixel the mirror image of a pixel may land and still count as that pixel. A view's coordinates
+// carry a few dozen bits more than its pixel spacing needs (see FractalRect::requiredDigits()), so one that is meant
+// to line up with the axis comes out well within this, while one that is off by part of a pixel doesn't.
+const double tolerance = 1.0 / (1 << 24);
+
+// finds index such that pixels i and index - i along one axis of a view are mirror images of each other about 0, given
+// the coordinate of pixel 0 and the distance between pixels; returns false if they don't line up, or only do outside
+// of the count pixels along the axis
+bool mirrorIndex(const big_float &first, const big_float &spacing, int count, int &index)
+{
+    const big_float exact = -2 * first / spacing;
+    if (boost::multiprecision::abs(exact) > 2 * count)
+        return false;
+
+    const big_float rounded = boost::multiprecision::round(exact);
+    if (boost::multiprecision::abs(big_float{exact - rounded}) > tolerance)
+        return false;
+
+    index = rounded.convert_to<int>();
+    return true;
+}
+}
+
+Mirror::Mirror(const FractalRect &view, Symmetry symmetry)
+    : m_symmetry{symmetry}
+{
+    const QRectF &visualRect = view.visualRect();
+    const QSize size = visualRect.size().toSize();
+    if (symmetry == Symmetry::None || size.isEmpty())
+        return;
+
+    // the same mapping as PixelStepper's
+    const auto first = view.getFractalValueFromVisualPoint(0, 0);
+    if (!mirrorIndex(first.imag(), big_float{view.height() / visualRect.height()}, size.height(), m_rows))
+        return;
+
+    // every row past the axis that has its mirror image in the view
+    QRect area{QPoint{0, m_rows / 2 + 1}, QPoint{size.width() - 1, std::min(m_rows, size.height() - 1)}};
+    if (symmetry == Symmetry::Origin)
+    {
+        // and of those, only the columns that have theirs in it as well
+        if (!mirrorIndex(first.real(), big_float{view.width() / visualRect.width()}, size.width(), m_columns))
+            return;
+        area.setLeft(std::max(m_columns - (size.width() - 1), 0));
+        area.setRight(std::min(m_columns, size.width() - 1));
+    }
+    m_area = area;
+}
+
+QPoint Mirror::source(const QPoint &pixel) const
+{
+    return QPoint{m_symmetry == Symmetry::Origin ? m_columns - pixel.x() : pixel.x(), m_rows - pixel.y()};
+}
@@ -0,0 +1,40 @@
+#ifndef MIRROR_H
+#define MIRROR_H
+
+#include <QPoint>
+#include <QRect>
+
+#include "Common.h"
+#include "FractalRect.h"
+
+// The pixels of a view that the symmetry of its formula maps onto other pixels of the same view. Their iteration counts
+// are the same as those of the pixels they land on, so where a view straddles the real axis (or the origin) only one
+// side of it needs calculating. That only holds if they land exactly on a pixel: a view that sits a fraction of a pixel
+// off the axis doesn't mirror onto itself at all, and gets no mirror.
+//
+// The pixels that mirror others are the ones further down the image than the real axis, so the pixels they mirror are
+// never mirrored themselves.
+class Mirror
+{
+public:
+    Mirror() = default;
+    // pixel (i, j) of view is its visual point (i, j), as for PixelStepper
+    Mirror(const FractalRect &view, Symmetry symmetry);
+
+    // whether any of the view's pixels mirror others
+    bool isValid() const { return !m_area.isEmpty(); }
+    // whether every pixel of area mirrors another one
+    bool covers(const QRect &area) const { return m_area.contains(area); }
+    // the pixel that pixel mirrors; only meaningful for pixels covers() is true for
+    QPoint source(const QPoint &pixel) const;
+
+private:
+    Symmetry m_symmetry{Symmetry::None};
+    // the columns and rows that are mirror images of column i and row j are m_columns - i and m_rows - j
+    int m_columns{0};
+    int m_rows{0};
+    // the pixels that mirror others
+    QRect m_area;
+};
+
+#endif // MIRROR_H
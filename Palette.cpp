@@ -0,0 +1,78 @@
+#include "Palette.h"
+
+#include <QColor>
+
+#include <algorithm>
+#include <cmath>
+
+// the original fracture coloring; note that `255 / iterations` is an integer division, so everything past 255
+// iterations ends up the same color
+static QRgb classicColor(int iterations)
+{
+    iterations = std::max(iterations, 1);
+    return qRgb(255 - std::min(static_cast<int>(255 / iterations / 0.8) + 50, 255),
+                255 - std::min(static_cast<int>(255 / iterations / 2) + 50, 255),
+                255 - std::min(static_cast<int>(255 / iterations / 4) + 50, 255));
+}
+
+static QRgb mix(QRgb from, QRgb to, double amount)
+{
+    return qRgb(qRound(qRed(from) + (qRed(to) - qRed(from)) * amount),
+                qRound(qGreen(from) + (qGreen(to) - qGreen(from)) * amount),
+                qRound(qBlue(from) + (qBlue(to) - qBlue(from)) * amount));
+}
+
+// the gradient palettes repeat themselves every this many iterations
+constexpr int gradientPeriod = 32;
+
+Palette::Palette(Scheme scheme, int maxIterations, bool smooth)
+    : m_scheme{scheme},
+      m_smooth{smooth},
+      m_stepsPerIteration{smooth ? 16 : 1}
+{
+    if (scheme == Classic)
+    {
+        const int iterations = std::min(maxIterations, 256) + 2;
+        m_tableSize = iterations * m_stepsPerIteration;
+        m_table.resize(m_tableSize);
+        for (int i = 0; i < m_tableSize; ++i)
+        {
+            const int whole = i / m_stepsPerIteration;
+            const double fraction = static_cast<double>(i % m_stepsPerIteration) / m_stepsPerIteration;
+            m_table[i] = mix(classicColor(whole), classicColor(whole + 1), fraction);
+        }
+        return;
+    }
+
+    QVector<QRgb> stops;
+    switch (scheme)
+    {
+    case Fire:
+        stops = {qRgb(20, 0, 0), qRgb(180, 20, 0), qRgb(255, 140, 0), qRgb(255, 240, 120), qRgb(255, 255, 255), qRgb(120, 30, 0)};
+        break;
+    case Ocean:
+        stops = {qRgb(0, 7, 40), qRgb(0, 60, 140), qRgb(30, 160, 220), qRgb(200, 240, 255), qRgb(255, 200, 60), qRgb(0, 30, 90)};
+        break;
+    default:
+        stops = {qRgb(0, 0, 0), qRgb(255, 255, 255)};
+        break;
+    }
+
+    m_cyclic = true;
+    m_tableSize = gradientPeriod * m_stepsPerIteration;
+    m_table.resize(m_tableSize);
+    for (int i = 0; i < m_tableSize; ++i)
+    {
+        // walk around the stops and wrap back to the first one, so the cycle has no seam
+        const double position = static_cast<double>(i) / m_tableSize * stops.size();
+        const int stop = static_cast<int>(position);
+        m_table[i] = mix(stops[stop], stops[(stop + 1) % stops.size()], position - stop);
+    }
+}
+
+void Palette::colorize(const float *values, QRgb *pixels, int count) const
+{
+    for (int i = 0; i < count; ++i)
+        if (values[i] != notCalculated)
+            pixels[i] = color(values[i]);
+}
@@ -0,0 +1,54 @@
+#ifndef PALETTE_H
+#define PALETTE_H
+
+#include <QRgb>
+#include <QVector>
+
+// Maps the smoothed iteration counts the kernels produce onto colors. The mapping is baked into a lookup table with a
+// few entries per iteration, so coloring a pixel is just a multiply and a table lookup.
+class Palette
+{
+public:
+    enum Scheme
+    {
+        Classic,
+        Fire,
+        Ocean,
+        Grayscale,
+    };
+
+    // the value the iteration buffer holds for pixels that haven't been calculated yet
+    static constexpr float notCalculated = -1;
+
+    Palette(Scheme scheme = Classic, int maxIterations = 25, bool smooth = true);
+
+    Scheme scheme() const { return m_scheme; }
+    bool isSmooth() const { return m_smooth; }
+
+    QRgb color(float value) const
+    {
+        if (value <= 0)
+            return value == 0 ? m_interiorColor : 0;
+
+        auto index = static_cast<int>(value * m_stepsPerIteration);
+        if (m_cyclic)
+            index %= m_tableSize;
+        else if (index >= m_tableSize)
+            index = m_tableSize - 1;
+        return m_table[index];
+    }
+
+    // colors count values into pixels; pixels that haven't been calculated yet are left untouched
+    void colorize(const float *values, QRgb *pixels, int count) const;
+
+private:
+    Scheme m_scheme;
+    bool m_smooth;
+    bool m_cyclic{false};
+    int m_stepsPerIteration;
+    QRgb m_interiorColor{qRgb(0, 0, 0)};
+    QVector<QRgb> m_table;
+    int m_tableSize;
+};
+
+#endif // PALETTE_H
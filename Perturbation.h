@@ -0,0 +1,356 @@
+#ifndef PERTURBATION_H
+#define PERTURBATION_H
+
+#include <QPointF>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "Common.h"
+#include "Formulas.h"
+#include "FractalRect.h"
+#include "Kernels.h"
+
+// Deep zoom support via perturbation theory. Instead of iterating every pixel in MPFR, we iterate a single reference
+// point in full precision and then only track how far each pixel's orbit is from the reference orbit. Those offsets
+// are tiny, but they are tiny *relative to each other*, so hardware floats handle them just fine.
+//
+// Glitches (pixels whose orbit wanders away from the reference so far that the offset loses its precision) are
+// detected by comparing the size of the offset against the size of the full value; when that happens we rebase the
+// pixel onto the start of the reference orbit, which keeps the offset small without needing a second reference.
+// See <https://mathr.co.uk/blog/2021-05-14_deep_zoom_theory_and_practice.html> for the details of the technique.
+//
+// D is the scalar type the offsets are tracked in; double is plenty up to zooms of roughly 1e-280, past that the
+// offsets underflow and long double has to take over thanks to its larger exponent range.
+
+// The orbit of the reference point, rounded down to D. It only depends on the point and the iteration budget, so views
+// that share their center (like the frames of a zoom sequence) can share it as well.
+template<typename D>
+struct ReferenceOrbit
+{
+    // reference is the point the orbit is computed for (normally the center of the view). Setting cancelled cuts the
+    // orbit short, after which the results are meaningless.
+    ReferenceOrbit(Formula formula, const complex &reference, const complex &juliaConstant, int maxIterations,
+                   const std::atomic<bool> *cancelled = nullptr)
+        : formula{formula},
+          lastIndex{lastIndexFor(formula, maxIterations)}
+    {
+        const bool julia = formula == Formula::Julia;
+        const big_float cReal = julia ? juliaConstant.real() : reference.real();
+        const big_float cImag = julia ? juliaConstant.imag() : reference.imag();
+        // the Mandelbrot-like orbits start at zero, which has to get the reference's digits explicitly (see PrecisionGuard)
+        big_float zReal = julia ? reference.real() : big_float{0, reference.real().precision()};
+        big_float zImag = julia ? reference.imag() : big_float{0, reference.imag().precision()};
+
+        real.reserve(lastIndex + 1);
+        imag.reserve(lastIndex + 1);
+        for (int i = 0; i <= lastIndex; ++i)
+        {
+            real.push_back(zReal.convert_to<D>());
+            imag.push_back(zImag.convert_to<D>());
+            // we need at least two points to have something to rebase onto
+            if (i > 0 && (zReal * zReal + zImag * zImag > 4 || isCancelled(cancelled, i)))
+                break;
+
+            big_float nextReal = zReal * zReal - zImag * zImag + cReal;
+            big_float nextImag = 2 * zReal * zImag + cImag;
+            if (formula == Formula::BurningShip)
+            {
+                // the offsets need the values from before the absolute value was taken to figure out which side of the
+                // fold they end up on
+                foldReal.push_back(nextReal.convert_to<D>());
+                foldImag.push_back(nextImag.convert_to<D>());
+                nextReal = boost::multiprecision::abs(nextReal);
+                nextImag = boost::multiprecision::abs(nextImag);
+            }
+            zReal = nextReal;
+            zImag = nextImag;
+        }
+    }
+
+    // the index of the last iteration a point gets; the direct kernels count the escape of z_1 and z_2 (Mandelbrot,
+    // Burning Ship) or z_0 and z_1 (Julia) both as one iteration, which shifts it by one
+    static int lastIndexFor(Formula formula, int maxIterations)
+    {
+        return formula == Formula::Julia ? maxIterations : maxIterations + 1;
+    }
+
+    Formula formula;
+    int lastIndex;
+    std::vector<D> real;
+    std::vector<D> imag;
+    // Burning Ship only: the orbit right before the absolute value is taken
+    std::vector<D> foldReal;
+    std::vector<D> foldImag;
+};
+
+template<typename D>
+class Perturbation
+{
+public:
+    // reference is the point the reference orbit is computed for (normally the center of the view), radius is the
+    // largest distance between the reference and any pixel, and spacing is the distance between two pixels. Setting
+    // cancelled cuts the reference orbit short, after which the results are meaningless.
+    Perturbation(Formula formula, const complex &reference, const complex &juliaConstant, int maxIterations, D radius, D spacing,
+                 const std::atomic<bool> *cancelled = nullptr)
+        : Perturbation{std::make_shared<const ReferenceOrbit<D>>(formula, reference, juliaConstant, maxIterations, cancelled), maxIterations,
+                       radius, spacing}
+    {}
+
+    // reuses an orbit that was computed for at least maxIterations; the results are the same as with an orbit of its own
+    Perturbation(std::shared_ptr<const ReferenceOrbit<D>> orbit, int maxIterations, D radius, D spacing)
+        : m_formula{orbit->formula},
+          m_lastIndex{ReferenceOrbit<D>::lastIndexFor(m_formula, maxIterations)},
+          m_orbit{std::move(orbit)},
+          m_orbitSize{std::min(static_cast<int>(m_orbit->real.size()), m_lastIndex + 1)}
+    {
+        if (m_formula != Formula::BurningShip)
+            computeSeries(radius, spacing);
+    }
+
+    // returns the same smoothed iteration count the direct kernels in Kernels.h would for the pixel that is offset from the
+    // reference point by (deltaReal, deltaImag)
+    float calculatePoint(const D &deltaReal, const D &deltaImag, const std::atomic<bool> *cancelled = nullptr) const
+    {
+        // for the Mandelbrot-style formulas the offset is in c and z starts out at the critical point; for Julia sets
+        // the offset is in the starting z and c is fixed
+        const D dcReal = m_formula == Formula::Julia ? D{0} : deltaReal;
+        const D dcImag = m_formula == Formula::Julia ? D{0} : deltaImag;
+
+        D dzReal{0};
+        D dzImag{0};
+        if (m_formula == Formula::Julia)
+        {
+            dzReal = deltaReal;
+            dzImag = deltaImag;
+        }
+
+        int index = 0;
+        if (m_seriesSkip > 0)
+        {
+            // evaluate the series A*d + B*d^2 + C*d^3 to jump straight past the iterations it covers
+            const D d2Real = deltaReal * deltaReal - deltaImag * deltaImag;
+            const D d2Imag = 2 * deltaReal * deltaImag;
+            const D d3Real = d2Real * deltaReal - d2Imag * deltaImag;
+            const D d3Imag = d2Real * deltaImag + d2Imag * deltaReal;
+            dzReal = m_aReal * deltaReal - m_aImag * deltaImag + m_bReal * d2Real - m_bImag * d2Imag + m_cReal * d3Real - m_cImag * d3Imag;
+            dzImag = m_aReal * deltaImag + m_aImag * deltaReal + m_bReal * d2Imag + m_bImag * d2Real + m_cReal * d3Imag + m_cImag * d3Real;
+            index = m_seriesSkip;
+        }
+
+        const auto &orbitReal = m_orbit->real;
+        const auto &orbitImag = m_orbit->imag;
+        const int orbitEnd = m_orbitSize - 1;
+        int referenceIndex = index;
+        while (true)
+        {
+            const D real = orbitReal[referenceIndex] + dzReal;
+            const D imag = orbitImag[referenceIndex] + dzImag;
+            const D magnitude = real * real + imag * imag;
+            if (magnitude > 4)
+                return smoothIterations(iterationsForEscapeIndex(index), static_cast<double>(magnitude));
+            if (index == m_lastIndex || isCancelled(cancelled, index))
+                return 0;
+
+            // glitch: the offset has grown bigger than the value itself (or we've run off the end of the reference
+            // orbit), so re-express the pixel relative to the start of the reference orbit
+            if (magnitude < dzReal * dzReal + dzImag * dzImag || referenceIndex == orbitEnd)
+            {
+                dzReal = real - orbitReal[0];
+                dzImag = imag - orbitImag[0];
+                referenceIndex = 0;
+            }
+
+            step(referenceIndex, dzReal, dzImag, dcReal, dcImag);
+            ++referenceIndex;
+            ++index;
+        }
+    }
+
+    int seriesSkip() const { return m_seriesSkip; }
+
+private:
+    // the direct kernels count the escape of z_1 and z_2 (Mandelbrot, Burning Ship) or z_0 and z_1 (Julia) both as one
+    // iteration, so mirror that here
+    int iterationsForEscapeIndex(int index) const
+    {
+        return std::max(1, m_formula == Formula::Julia ? index : index - 1);
+    }
+
+    // approximate the pixel offsets as a cubic in the pixel's initial offset; while the cubic term stays well below the
+    // distance between neighbouring pixels, every pixel can skip straight past those iterations
+    void computeSeries(const D &radius, const D &spacing)
+    {
+        const bool julia = m_formula == Formula::Julia;
+        D aReal = julia ? D{1} : D{0};
+        D aImag{0}, bReal{0}, bImag{0}, cReal{0}, cImag{0};
+        const D radius2 = radius * radius;
+        const D radius3 = radius2 * radius;
+
+        const auto &orbitReal = m_orbit->real;
+        const auto &orbitImag = m_orbit->imag;
+        if (julia && std::hypot(orbitReal[0], orbitImag[0]) + radius >= 2)
+            return;
+
+        for (int n = 0; n + 1 < m_orbitSize - 1; ++n)
+        {
+            const D zReal = 2 * orbitReal[n];
+            const D zImag = 2 * orbitImag[n];
+
+            const D nextAReal = zReal * aReal - zImag * aImag + (julia ? 0 : 1);
+            const D nextAImag = zReal * aImag + zImag * aReal;
+            const D nextBReal = zReal * bReal - zImag * bImag + aReal * aReal - aImag * aImag;
+            const D nextBImag = zReal * bImag + zImag * bReal + 2 * aReal * aImag;
+            const D nextCReal = zReal * cReal - zImag * cImag + 2 * (aReal * bReal - aImag * bImag);
+            const D nextCImag = zReal * cImag + zImag * cReal + 2 * (aReal * bImag + aImag * bReal);
+
+            const D a = std::hypot(nextAReal, nextAImag);
+            const D b = std::hypot(nextBReal, nextBImag);
+            const D c = std::hypot(nextCReal, nextCImag);
+            if (!std::isfinite(c) || c * radius3 > seriesTolerance * a * spacing)
+                break;
+            // no pixel may escape during the iterations we skip, or its iteration count would be wrong
+            if (std::hypot(orbitReal[n + 1], orbitImag[n + 1]) + a * radius + b * radius2 + c * radius3 >= 2)
+                break;
+
+            aReal = nextAReal;
+            aImag = nextAImag;
+            bReal = nextBReal;
+            bImag = nextBImag;
+            cReal = nextCReal;
+            cImag = nextCImag;
+            m_seriesSkip = n + 1;
+        }
+
+        m_aReal = aReal;
+        m_aImag = aImag;
+        m_bReal = bReal;
+        m_bImag = bImag;
+        m_cReal = cReal;
+        m_cImag = cImag;
+    }
+
+    // |a + d| - |a|, computed without cancellation
+    static D diffAbs(const D &a, const D &d)
+    {
+        if (a >= 0)
+            return a + d >= 0 ? d : D{-(2 * a + d)};
+        return a + d > 0 ? D{2 * a + d} : D{-d};
+    }
+
+    void step(int index, D &dzReal, D &dzImag, const D &dcReal, const D &dcImag) const
+    {
+        const D &zReal = m_orbit->real[index];
+        const D &zImag = m_orbit->imag[index];
+
+        if (m_formula == Formula::BurningShip)
+        {
+            const D foldReal = (2 * zReal + dzReal) * dzReal - (2 * zImag + dzImag) * dzImag + dcReal;
+            const D foldImag = 2 * (zReal * dzImag + zImag * dzReal + dzReal * dzImag) + dcImag;
+            dzReal = diffAbs(m_orbit->foldReal[index], foldReal);
+            dzImag = diffAbs(m_orbit->foldImag[index], foldImag);
+            return;
+        }
+
+        // dz' = 2 * Z * dz + dz^2 + dc = (2 * Z + dz) * dz + dc
+        const D twoZPlusDzReal = 2 * zReal + dzReal;
+        const D twoZPlusDzImag = 2 * zImag + dzImag;
+        const D nextReal = twoZPlusDzReal * dzReal - twoZPlusDzImag * dzImag + dcReal;
+        dzImag = twoZPlusDzReal * dzImag + twoZPlusDzImag * dzReal + dcImag;
+        dzReal = nextReal;
+    }
+
+    // how small the cubic term of the series has to stay relative to the distance between neighbouring pixels
+    static constexpr double seriesTolerance = 1e-3;
+
+    Formula m_formula;
+    int m_lastIndex;
+
+    std::shared_ptr<const ReferenceOrbit<D>> m_orbit;
+    // the part of the orbit this budget gets to use
+    int m_orbitSize;
+
+    int m_seriesSkip{0};
+    D m_aReal{}, m_aImag{}, m_bReal{}, m_bImag{}, m_cReal{}, m_cImag{};
+};
+
+// Whether a view gets calculated as offsets from a reference orbit rather than with the direct kernels: only once it
+// needs more precision than long double (up to there, the hardware types are faster), only with deep zoom on, and only
+// for the formulas Perturbation knows.
+inline bool usesPerturbation(Formula formula, bool deepZoom, Precision precision)
+{
+    return deepZoom && precision >= Precision::Float128 && formulaInfo(formula).perturbation;
+}
+
+// whether the offsets of pixels spacing apart have to be tracked in long double; in double, they underflow somewhere
+// below 1e-300
+inline bool needsExtendedOffsets(const big_float &spacing)
+{
+    return spacing <= 1e-280;
+}
+
+// The perturbation a view gets calculated with: the offsets in double or long double, whichever the view's pixel spacing
+// needs, from a reference orbit at the center of the view. The viewer, fracture-render, the zoom animation and the
+// supersampler all set theirs up through this, so they can't end up calculating the same view differently.
+class ViewPerturbation
+{
+public:
+    // the orbits, if given, were calculated for referencePoint(view) ahead of time, for at least maxIterations; the one
+    // the view doesn't need is ignored, and the view calculates its own if the one it does need is empty. Setting
+    // cancelled cuts that orbit short, after which the results are meaningless.
+    ViewPerturbation(const FractalRect &view, Formula formula, const complex &juliaConstant, int maxIterations,
+                     const std::atomic<bool> *cancelled = nullptr, std::shared_ptr<const ReferenceOrbit<double>> orbit = {},
+                     std::shared_ptr<const ReferenceOrbit<long double>> extendedOrbit = {})
+        : m_referencePixel{view.visualRect().center()},
+          m_spacing{view.width() / view.visualRect().width()}
+    {
+        // the series has to cover every pixel, and the corners are the farthest from the reference
+        const auto radius = std::hypot(view.visualRect().width(), view.visualRect().height()) / 2;
+        if (needsExtendedOffsets(m_spacing))
+        {
+            if (!extendedOrbit)
+                extendedOrbit = std::make_shared<const ReferenceOrbit<long double>>(formula, referencePoint(view), juliaConstant, maxIterations,
+                                                                                    cancelled);
+            m_extendedPerturbation = std::make_unique<Perturbation<long double>>(std::move(extendedOrbit), maxIterations,
+                                                                                 m_spacing.convert_to<long double>() * radius,
+                                                                                 m_spacing.convert_to<long double>());
+        }
+        else
+        {
+            if (!orbit)
+                orbit = std::make_shared<const ReferenceOrbit<double>>(formula, referencePoint(view), juliaConstant, maxIterations, cancelled);
+            m_perturbation = std::make_unique<Perturbation<double>>(std::move(orbit), maxIterations, m_spacing.convert_to<double>() * radius,
+                                                                    m_spacing.convert_to<double>());
+        }
+    }
+
+    // the point the reference orbit of view is calculated for
+    static complex referencePoint(const FractalRect &view)
+    {
+        return view.getFractalValueFromVisualPoint(view.visualRect().center());
+    }
+
+    // the pixel the offsets are taken from
+    const QPointF &referencePixel() const { return m_referencePixel; }
+
+    // calls calculate with the Perturbation and the pixel spacing, both in the type the offsets are tracked in
+    template<typename Calculator>
+    void visit(const Calculator &calculate) const
+    {
+        if (m_perturbation)
+            calculate(*m_perturbation, m_spacing.convert_to<double>());
+        else
+            calculate(*m_extendedPerturbation, m_spacing.convert_to<long double>());
+    }
+
+private:
+    QPointF m_referencePixel;
+    big_float m_spacing;
+    std::unique_ptr<Perturbation<double>> m_perturbation;
+    std::unique_ptr<Perturbation<long double>> m_extendedPerturbation;
+};
+
+#endif // PERTURBATION_H
@@ -0,0 +1,57 @@
+#ifndef PIXELSTEPPER_H
+#define PIXELSTEPPER_H
+
+#include "Common.h"
+#include "FractalRect.h"
+#include "Kernels.h"
+
+// Maps the pixels of a view onto the fractal plane in the scalar type T. The origin and the distance between pixels
+// get converted once per tile, and from then on every pixel is origin + index * spacing, worked out in place in the
+// stepper's own storage. For MPFR that means walking across a tile doesn't allocate anything, where
+// FractalRect::getFractalValueFromVisualPoint() takes a handful of temporaries for every pixel.
+template<typename T>
+class PixelStepper
+{
+public:
+    explicit PixelStepper(const FractalRect &view)
+    {
+        const auto &visualRect = view.visualRect();
+        const auto origin = view.getFractalValueFromVisualPoint(0, 0);
+        m_originReal = scalar_cast<T>(origin.real());
+        m_originImag = scalar_cast<T>(origin.imag());
+        m_stepReal = scalar_cast<T>(big_float{view.width() / visualRect.width()});
+        m_stepImag = scalar_cast<T>(big_float{view.height() / visualRect.height()});
+        m_real = m_originReal;
+        m_imag = m_originImag;
+    }
+
+    // the distance between two columns
+    const T &spacing() const { return m_stepReal; }
+
+    // the real part of the pixels in column and the imaginary part of the ones in row; the references stay valid until
+    // the next call
+    const T &real(int column)
+    {
+        m_real = m_stepReal;
+        m_real *= column;
+        m_real += m_originReal;
+        return m_real;
+    }
+    const T &imag(int row)
+    {
+        m_imag = m_stepImag;
+        m_imag *= row;
+        m_imag += m_originImag;
+        return m_imag;
+    }
+
+private:
+    T m_originReal;
+    T m_originImag;
+    T m_stepReal;
+    T m_stepImag;
+    T m_real;
+    T m_imag;
+};
+
+#endif // PIXELSTEPPER_H
@@ -0,0 +1,109 @@
+#include "PngWriter.h"
+
+#include <QFile>
+
+#include <png.h>
+
+// libpng reports errors by calling this and expects it to never return, so we keep the message around and jump back
+// to the setjmp() in whichever function called into it
+static void handleError(png_structp png, png_const_charp message)
+{
+    *static_cast<QString *>(png_get_error_ptr(png)) = QString::fromUtf8(message);
+    png_longjmp(png, 1);
+}
+
+static void ignoreWarning(png_structp, png_const_charp)
+{}
+
+PngWriter::~PngWriter()
+{
+    abort();
+}
+
+bool PngWriter::open(const QString &fileName, const QSize &size)
+{
+    abort();
+
+    m_file = std::fopen(QFile::encodeName(fileName).constData(), "wb");
+    if (!m_file)
+    {
+        m_error = QStringLiteral("could not open %1 for writing").arg(fileName);
+        return false;
+    }
+
+    m_png = png_create_write_struct(PNG_LIBPNG_VER_STRING, &m_error, handleError, ignoreWarning);
+    m_info = m_png ? png_create_info_struct(m_png) : nullptr;
+    if (!m_info)
+    {
+        m_error = QStringLiteral("out of memory");
+        abort();
+        return false;
+    }
+
+    if (setjmp(png_jmpbuf(m_png)))
+    {
+        abort();
+        return false;
+    }
+
+    png_init_io(m_png, m_file);
+    png_set_IHDR(m_png, m_info, size.width(), size.height(), 8, PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
+                 PNG_FILTER_TYPE_DEFAULT);
+    png_write_info(m_png, m_info);
+
+    m_width = size.width();
+    m_row.resize(static_cast<size_t>(m_width) * 3);
+    return true;
+}
+
+bool PngWriter::writeRow(const QRgb *pixels)
+{
+    if (!m_png)
+        return false;
+
+    for (int x = 0; x < m_width; ++x)
+    {
+        m_row[x * 3] = qRed(pixels[x]);
+        m_row[x * 3 + 1] = qGreen(pixels[x]);
+        m_row[x * 3 + 2] = qBlue(pixels[x]);
+    }
+
+    if (setjmp(png_jmpbuf(m_png)))
+    {
+        abort();
+        return false;
+    }
+    png_write_row(m_png, m_row.data());
+    return true;
+}
+
+bool PngWriter::close()
+{
+    if (!m_png)
+        return false;
+
+    if (setjmp(png_jmpbuf(m_png)))
+    {
+        abort();
+        return false;
+    }
+    png_write_end(m_png, nullptr);
+    png_destroy_write_struct(&m_png, &m_info);
+
+    const bool flushed = std::fclose(m_file) == 0;
+    m_file = nullptr;
+    if (!flushed)
+        m_error = QStringLiteral("could not finish writing the file");
+    return flushed;
+}
+
+void PngWriter::abort()
+{
+    if (m_png)
+        png_destroy_write_struct(&m_png, m_info ? &m_info : nullptr);
+    m_png = nullptr;
+    m_info = nullptr;
+    if (m_file)
+        std::fclose(m_file);
+    m_file = nullptr;
+}
@@ -0,0 +1,45 @@
+#ifndef PNGWRITER_H
+#define PNGWRITER_H
+
+#include <QRgb>
+#include <QSize>
+#include <QString>
+
+#include <cstdio>
+#include <vector>
+
+struct png_struct_def;
+struct png_info_def;
+
+// Writes a PNG one row at a time, top to bottom. Unlike QImage::save() this never needs the whole image in memory, so
+// it can save images far bigger than RAM as they're being rendered.
+class PngWriter
+{
+public:
+    PngWriter() = default;
+    ~PngWriter();
+
+    PngWriter(const PngWriter &) = delete;
+    PngWriter &operator=(const PngWriter &) = delete;
+
+    // creates the file and writes the header for an 8 bit RGB image of the given size
+    bool open(const QString &fileName, const QSize &size);
+    // pixels has to hold size.width() pixels; the alpha channel is dropped
+    bool writeRow(const QRgb *pixels);
+    // writes the end of the file; this has to be called after the last row or the file is incomplete
+    bool close();
+
+    QString errorString() const { return m_error; }
+
+private:
+    void abort();
+
+    std::FILE *m_file{nullptr};
+    png_struct_def *m_png{nullptr};
+    png_info_def *m_info{nullptr};
+    std::vector<unsigned char> m_row;
+    int m_width{0};
+    QString m_error;
+};
+
+#endif // PNGWRITER_H
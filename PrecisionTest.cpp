@@ -0,0 +1,168 @@
+#include <QRectF>
+
+#include <cstdint>
+#include <cstdio>
+#include <iterator>
+#include <limits>
+#include <vector>
+
+#include "Common.h"
+#include "Formulas.h"
+#include "FractalRect.h"
+#include "Kernels.h"
+#include "PixelStepper.h"
+
+// Checks that the precision tiers FractalRect::requiredPrecision() picks from agree where it switches between them:
+// the views just either side of every boundary get calculated in the types on both sides of it, and every pixel has
+// to come out with the same iteration count in both. Exits with 1 (and lists the differences) if any of them don't.
+
+namespace
+{
+
+// the views are this many pixels across; few enough to calculate every one of them in MPFR
+constexpr int viewSize = 32;
+constexpr int maxIterations = 500;
+// how far either side of a boundary the views are, as a factor on the width
+constexpr double boundaryMargin = 1.01;
+// how many pixels of a view may tip over between two types
+constexpr int allowedMismatches = 8;
+
+// the basilica, whose Julia set has an inside for the centers to border on (the viewer's default has none)
+const complex juliaConstant{-1, 0};
+
+// a point on the edge of every formula, in the order of the Formula enum, with detail around it at any depth. The
+// escape-time ones are Misiurewicz points, whose orbits land on a repelling cycle: i, -2 and the points the Multibrot
+// sets send straight to a fixed point for the Mandelbrot-like formulas, and the basilica's repelling fixed point for
+// the Julia set. Newton's is the point its first step sends to the pole at 0.
+const char *const centers[][2] = {
+    {"0", "1"},
+    {"1.61803398874989484820458683436563811772030917980576", "0"},
+    {"-1.54368901269207636157085597180174798652520329765098", "0"},
+    {"0.340625019316606640194394244037830888977210102549125", "1.27122987841870623913561299102106497672841432822678"},
+    {"0.629960524947436582383605303639114175285125732350754", "1.09112363597172140356007261418980888132587333874030"},
+    {"-1.54368901269207636157085597180174798652520329765098", "0"},
+    {"-0.793700525984099737375852819636154130195746663949927", "0"},
+};
+static_assert(std::size(centers) == RegisteredFormulas::infos.size(), "every formula needs a center");
+
+FractalRect makeView(const complex &center, const big_float &width)
+{
+    auto view = FractalRect::centered(center, width, QRectF{0, 0, viewSize, viewSize});
+    view.setPrecision(view.requiredDigits());
+    return view;
+}
+
+template<typename T>
+std::vector<std::int64_t> iterationCounts(Formula formula, const FractalRect &view)
+{
+    PrecisionGuard guard{view.requiredDigits()};
+    PixelStepper<T> stepper{view};
+    const T spacing = stepper.spacing();
+    const KernelParameters<T> parameters{scalar_cast<T>(juliaConstant.real()), scalar_cast<T>(juliaConstant.imag()), maxIterations,
+                                         periodTolerance(spacing)};
+
+    std::vector<std::int64_t> counts;
+    visitFormula(formula, [&](auto kernel) {
+        for (int j = 0; j < viewSize; ++j)
+        {
+            const T imag = stepper.imag(j);
+            for (int i = 0; i < viewSize; ++i)
+                counts.push_back(iterationsSpent(decltype(kernel)::calculatePoint(stepper.real(i), imag, parameters), maxIterations));
+        }
+    });
+    return counts;
+}
+
+std::vector<std::int64_t> iterationCounts(Precision precision, Formula formula, const FractalRect &view)
+{
+    switch (precision)
+    {
+    case Precision::Double:
+        return iterationCounts<double>(formula, view);
+    case Precision::LongDouble:
+        return iterationCounts<long double>(formula, view);
+#ifdef FRACTURE_HAS_FLOAT128
+    case Precision::Float128:
+        return iterationCounts<__float128>(formula, view);
+#endif
+    default:
+        return iterationCounts<big_float>(formula, view);
+    }
+}
+
+// the width at which a view around center stops fitting into precision, found by bisecting over the exponent
+big_float boundaryWidth(const complex &center, Precision precision)
+{
+    big_float wide{1};
+    big_float narrow{1e-60};
+    for (int i = 0; i < 100; ++i)
+    {
+        const big_float middle = sqrt(wide * narrow);
+        if (makeView(center, middle).requiredPrecision() <= precision)
+            wide = middle;
+        else
+            narrow = middle;
+    }
+    return wide;
+}
+
+}
+
+int main()
+{
+    // the tiers this build has, from cheapest to most precise
+    std::vector<Precision> tiers{Precision::Double};
+    if (std::numeric_limits<long double>::digits > std::numeric_limits<double>::digits)
+        tiers.push_back(Precision::LongDouble);
+#ifdef FRACTURE_HAS_FLOAT128
+    tiers.push_back(Precision::Float128);
+#endif
+    tiers.push_back(Precision::MultiPrecision);
+
+    int failures = 0;
+    for (const auto &info : formulas())
+    {
+        const auto &center = centers[static_cast<std::size_t>(info.id)];
+        const complex point{parseDecimal(center[0]), parseDecimal(center[1])};
+
+        for (std::size_t tier = 0; tier + 1 < tiers.size(); ++tier)
+        {
+            const Precision cheaper = tiers[tier];
+            const Precision pricier = tiers[tier + 1];
+            const big_float width = boundaryWidth(point, cheaper);
+
+            for (const big_float &sideWidth : {big_float{width * boundaryMargin}, big_float{width / boundaryMargin}})
+            {
+                const auto view = makeView(point, sideWidth);
+                const bool inside = sideWidth > width;
+                const Precision expected = inside ? cheaper : pricier;
+                const char *side = inside ? "inside" : "outside";
+                if (view.requiredPrecision() != expected)
+                {
+                    std::printf("%s, %s the %s boundary: picked %s instead of %s\n", info.name, side, precisionName(cheaper),
+                                precisionName(view.requiredPrecision()), precisionName(expected));
+                    ++failures;
+                }
+
+                const auto cheap = iterationCounts(cheaper, info.id, view);
+                const auto precise = iterationCounts(pricier, info.id, view);
+                int mismatches = 0;
+                for (std::size_t i = 0; i < cheap.size(); ++i)
+                    if (cheap[i] != precise[i])
+                        ++mismatches;
+                if (mismatches > allowedMismatches)
+                {
+                    std::printf("%s, %s the %s boundary: %d of %d pixels differ between %s and %s\n", info.name, side,
+                                precisionName(cheaper), mismatches, static_cast<int>(cheap.size()), precisionName(cheaper),
+                                precisionName(pricier));
+                    ++failures;
+                }
+            }
+        }
+    }
+
+    if (failures > 0)
+        return 1;
+    std::printf("all precision tiers agree at their boundaries\n");
+    return 0;
+}
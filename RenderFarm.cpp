@@ -0,0 +1,511 @@
+#include "RenderFarm.h"
+
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QEventLoop>
+#include <QLocalSocket>
+#include <QProcess>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+#include "Formulas.h"
+
+namespace
+{
+enum MessageType : quint8
+{
+    // coordinator to worker: the view, once after connecting
+    SetupMessage,
+    // coordinator to worker: a tile to calculate
+    TileMessage,
+    // worker to coordinator: the smoothed iteration counts of a tile
+    ResultMessage
+};
+
+// the tile a worker is calculating and the one it starts on next
+constexpr size_t tilesInFlight = 2;
+// how many bands can be in progress at once; later ones wait, so memory use doesn't depend on the height of the image
+constexpr int bandWindow = 4;
+
+// every message goes over the socket as a QByteArray, which QDataStream prefixes with its length, so the other end can
+// tell when it has all of it
+void sendMessage(QLocalSocket *socket, const QByteArray &message)
+{
+    QDataStream stream{socket};
+    stream << message;
+}
+
+// takes the next message off the socket if all of it has arrived
+bool readMessage(QLocalSocket *socket, QByteArray &message)
+{
+    QDataStream stream{socket};
+    stream.startTransaction();
+    stream >> message;
+    return stream.commitTransaction();
+}
+
+// coordinates go over the socket as exact decimal strings along with their precision, since the same string parsed
+// with more or fewer digits can come out as a different number
+void writeNumber(QDataStream &stream, const big_float &value)
+{
+    stream << static_cast<quint32>(value.precision()) << exactString(value);
+}
+
+// false if what's there isn't a number
+bool readNumber(QDataStream &stream, big_float &value)
+{
+    quint32 precision = 0;
+    QByteArray text;
+    stream >> precision >> text;
+    if (stream.status() != QDataStream::Ok || precision == 0)
+        return false;
+
+    try
+    {
+        value = big_float{text.toStdString(), precision};
+        return true;
+    }
+    catch (const std::runtime_error &)
+    {
+        return false;
+    }
+}
+}
+
+RenderFarm::RenderFarm(const BatchRenderer::Settings &settings, const Options &options, QObject *parent)
+    : QObject{parent},
+      m_settings{settings},
+      m_options{options},
+      m_palette{settings.scheme, settings.maxIterations, settings.smooth}
+{
+    m_options.workers = std::max(m_options.workers, 1);
+    m_options.threadsPerWorker = std::max(m_options.threadsPerWorker, 1);
+    m_options.maxAttempts = std::max(m_options.maxAttempts, 1);
+    m_restartsLeft = m_options.workers * m_options.maxAttempts;
+
+    // the bands are as tall as BatchRenderer's, and every tile is wide enough to keep all of a worker's threads busy
+    const QSize &size = m_settings.size;
+    const int bandHeight = TileScheduler::tileSize;
+    const int tileWidth = TileScheduler::tileSize * 2 * m_options.threadsPerWorker;
+    for (int top = 0; top < size.height(); top += bandHeight, ++m_bandCount)
+    {
+        for (int left = 0; left < size.width(); left += tileWidth)
+        {
+            m_queue.push_back(static_cast<int>(m_tiles.size()));
+            m_tiles.push_back(Tile{QRect{left, top, std::min(tileWidth, size.width() - left), std::min(bandHeight, size.height() - top)},
+                                   m_bandCount});
+        }
+    }
+
+    connect(&m_server, &QLocalServer::newConnection, this, &RenderFarm::workerConnected);
+}
+
+RenderFarm::~RenderFarm()
+{
+    finish(false);
+    // the workers exit once they notice the coordinator hung up, but one that's in the middle of a deep tile can take
+    // a while to notice
+    for (auto process : m_processes)
+    {
+        process->disconnect(this);
+        if (!process->waitForFinished(1000))
+        {
+            process->kill();
+            process->waitForFinished();
+        }
+    }
+}
+
+bool RenderFarm::render(const std::function<bool(const QRgb *pixels, const float *values)> &writeRow)
+{
+    m_writeRow = writeRow;
+
+    const QString name = QString{"fracture-farm-%1"}.arg(QCoreApplication::applicationPid());
+    // a coordinator that crashed can leave its socket behind
+    QLocalServer::removeServer(name);
+    // the workers get the view and send back tiles over this socket, which nobody else has any business connecting to
+    m_server.setSocketOptions(QLocalServer::UserAccessOption);
+    if (!m_server.listen(name))
+    {
+        m_error = m_server.errorString();
+        return false;
+    }
+
+    m_running = true;
+    m_clock.start();
+    for (int i = 0; i < m_options.workers; ++i)
+        startWorker(i == 0 ? m_options.crashAfter : 0);
+
+    QEventLoop loop;
+    m_loop = &loop;
+    loop.exec();
+    m_loop = nullptr;
+
+    return m_succeeded;
+}
+
+void RenderFarm::startWorker(int crashAfter)
+{
+    auto process = new QProcess{this};
+    // the workers' complaints end up next to the coordinator's
+    process->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    connect(process, &QProcess::errorOccurred, this, [this, process](QProcess::ProcessError error) {
+        if (error == QProcess::FailedToStart)
+            finish(false, "can't start a worker: " + process->errorString());
+    });
+    connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), this, [this, process] {
+        m_processes.erase(std::remove(m_processes.begin(), m_processes.end(), process), m_processes.end());
+        process->deleteLater();
+        if (!m_running)
+            return;
+
+        // workers only exit on their own when something went wrong; the tiles it had get taken care of when its
+        // connection drops
+        if (m_restartsLeft > 0)
+        {
+            --m_restartsLeft;
+            startWorker();
+        }
+        else if (m_processes.empty())
+        {
+            finish(false, "the workers keep dying");
+        }
+    });
+
+    QStringList arguments{"--worker", m_server.serverName(), "--threads", QString::number(m_options.threadsPerWorker)};
+    if (crashAfter > 0)
+        arguments << "--crash-after" << QString::number(crashAfter);
+    m_processes.push_back(process);
+    process->start(QCoreApplication::applicationFilePath(), arguments);
+}
+
+void RenderFarm::workerConnected()
+{
+    while (auto socket = m_server.nextPendingConnection())
+    {
+        m_workers.emplace(socket, Worker{});
+        connect(socket, &QLocalSocket::readyRead, this, [this, socket] { readResults(socket); });
+        connect(socket, &QLocalSocket::disconnected, this, [this, socket] { workerDisconnected(socket); });
+
+        QByteArray message;
+        QDataStream stream{&message, QIODevice::WriteOnly};
+        stream << quint8{SetupMessage} << static_cast<qint32>(m_settings.formula);
+        writeNumber(stream, m_settings.center.real());
+        writeNumber(stream, m_settings.center.imag());
+        writeNumber(stream, m_settings.width);
+        stream << m_settings.size << static_cast<qint32>(m_settings.maxIterations);
+        writeNumber(stream, m_settings.juliaConstant.real());
+        writeNumber(stream, m_settings.juliaConstant.imag());
+        stream << m_settings.deepZoom;
+        sendMessage(socket, message);
+        dispatch(socket);
+    }
+}
+
+void RenderFarm::workerDisconnected(QLocalSocket *socket)
+{
+    const auto found = m_workers.find(socket);
+    if (found == m_workers.end())
+        return;
+    const auto tiles = std::move(found->second.tiles);
+    m_workers.erase(found);
+    socket->deleteLater();
+
+    // its tiles go back to the front of the queue, in order, since they're holding up the oldest bands
+    for (auto sent = tiles.rbegin(); sent != tiles.rend(); ++sent)
+    {
+        Tile &tile = m_tiles[sent->first];
+        if (--tile.owners > 0 || tile.done)
+            continue;
+        if (++tile.attempts >= m_options.maxAttempts)
+        {
+            finish(false, QString{"the tile at %1,%2 took down %3 workers"}.arg(tile.rect.left()).arg(tile.rect.top()).arg(tile.attempts));
+            return;
+        }
+        m_queue.push_front(sent->first);
+    }
+    for (const auto &worker : m_workers)
+        dispatch(worker.first);
+}
+
+void RenderFarm::readResults(QLocalSocket *socket)
+{
+    QByteArray message;
+    while (m_running && readMessage(socket, message))
+    {
+        QDataStream stream{message};
+        quint8 type = 0;
+        qint32 tile = -1;
+        qint64 nanoseconds = 0;
+        QByteArray data;
+        stream >> type >> tile >> nanoseconds >> data;
+        if (type != ResultMessage || stream.status() != QDataStream::Ok || tile < 0 || tile >= static_cast<qint32>(m_tiles.size()))
+        {
+            finish(false, "a worker sent a message that makes no sense");
+            return;
+        }
+        tileFinished(socket, tile, nanoseconds, data);
+    }
+}
+
+void RenderFarm::tileFinished(QLocalSocket *socket, int index, qint64 nanoseconds, const QByteArray &data)
+{
+    auto &worker = m_workers.at(socket);
+    const auto sent = std::find_if(worker.tiles.begin(), worker.tiles.end(), [index](const auto &entry) { return entry.first == index; });
+    if (sent == worker.tiles.end())
+    {
+        finish(false, "a worker sent a tile it was never asked for");
+        return;
+    }
+    worker.tiles.erase(sent);
+
+    Tile &tile = m_tiles[index];
+    --tile.owners;
+    const qint64 pixels = static_cast<qint64>(tile.rect.width()) * tile.rect.height();
+    worker.pixels += pixels;
+    worker.nanoseconds += std::max<qint64>(nanoseconds, 1);
+
+    // if another worker took this one over, whichever came back first already filled it in
+    if (!tile.done)
+    {
+        const QByteArray values = qUncompress(data);
+        if (values.size() != pixels * static_cast<qint64>(sizeof(float)))
+        {
+            finish(false, "a worker sent a broken tile");
+            return;
+        }
+
+        const int imageWidth = m_settings.size.width();
+        Band &band = m_bands[tile.band];
+        if (band.values.empty())
+        {
+            band.values.resize(static_cast<size_t>(imageWidth) * tile.rect.height());
+            band.remainingTiles = static_cast<int>(std::count_if(m_tiles.begin(), m_tiles.end(),
+                                                                 [&tile](const Tile &other) { return other.band == tile.band; }));
+        }
+        for (int row = 0; row < tile.rect.height(); ++row)
+            std::memcpy(band.values.data() + static_cast<size_t>(row) * imageWidth + tile.rect.left(),
+                        values.constData() + static_cast<size_t>(row) * tile.rect.width() * sizeof(float), tile.rect.width() * sizeof(float));
+        tile.done = true;
+        --band.remainingTiles;
+
+        if (!writeBands())
+            return;
+    }
+
+    // a band that got written out may have made room for every worker, not just this one
+    for (const auto &other : m_workers)
+        dispatch(other.first);
+}
+
+void RenderFarm::dispatch(QLocalSocket *socket)
+{
+    auto &worker = m_workers.at(socket);
+    while (m_running && worker.tiles.size() < tilesInFlight && !m_queue.empty() && m_tiles[m_queue.front()].band < m_nextBand + bandWindow)
+    {
+        const int tile = m_queue.front();
+        m_queue.pop_front();
+        sendTile(socket, tile);
+    }
+
+    if (m_running && worker.tiles.empty())
+    {
+        const int tile = tileToTakeOver(socket);
+        if (tile >= 0)
+            sendTile(socket, tile);
+    }
+}
+
+int RenderFarm::tileToTakeOver(QLocalSocket *socket) const
+{
+    // in pixels per nanosecond; a worker that hasn't finished anything yet can't be judged
+    const auto throughput = [](const Worker &worker) {
+        return worker.nanoseconds > 0 ? static_cast<double>(worker.pixels) / worker.nanoseconds : 0.0;
+    };
+    const double ownThroughput = throughput(m_workers.at(socket));
+    if (ownThroughput == 0)
+        return -1;
+
+    const qint64 now = m_clock.nsecsElapsed();
+    int best = -1;
+    double bestSaving = 0;
+    for (const auto &[other, worker] : m_workers)
+    {
+        const double otherThroughput = throughput(worker);
+        if (other == socket || otherThroughput == 0)
+            continue;
+
+        // a worker calculates its tiles one after the other; the first has been running since it was sent, and one
+        // that's already taking longer than expected is assumed to be half done
+        double ready = 0;
+        bool first = true;
+        for (const auto &[index, sentAt] : worker.tiles)
+        {
+            const Tile &tile = m_tiles[index];
+            const double pixels = static_cast<double>(tile.rect.width()) * tile.rect.height();
+            const double expected = pixels / otherThroughput;
+            ready += first ? std::max(expected - (now - sentAt), expected / 2) : expected;
+            first = false;
+
+            const double saving = ready - pixels / ownThroughput;
+            if (!tile.done && tile.owners == 1 && saving > bestSaving)
+            {
+                best = index;
+                bestSaving = saving;
+            }
+        }
+    }
+    return best;
+}
+
+void RenderFarm::sendTile(QLocalSocket *socket, int index)
+{
+    m_workers.at(socket).tiles.emplace_back(index, m_clock.nsecsElapsed());
+    ++m_tiles[index].owners;
+
+    QByteArray message;
+    QDataStream stream{&message, QIODevice::WriteOnly};
+    stream << quint8{TileMessage} << static_cast<qint32>(index) << m_tiles[index].rect;
+    sendMessage(socket, message);
+}
+
+bool RenderFarm::writeBands()
+{
+    const int width = m_settings.size.width();
+    std::vector<QRgb> line(width);
+    for (auto band = m_bands.find(m_nextBand); band != m_bands.end() && band->second.remainingTiles == 0; band = m_bands.find(m_nextBand))
+    {
+        const auto &values = band->second.values;
+        for (size_t row = 0; row < values.size() / width; ++row)
+        {
+            const float *rowValues = values.data() + row * width;
+            m_palette.colorize(rowValues, line.data(), width);
+            if (!m_writeRow(line.data(), rowValues))
+            {
+                finish(false);
+                return false;
+            }
+        }
+        m_bands.erase(band);
+
+        if (++m_nextBand == m_bandCount)
+        {
+            finish(true);
+            return false;
+        }
+    }
+    return true;
+}
+
+void RenderFarm::finish(bool succeeded, const QString &error)
+{
+    if (!m_running)
+        return;
+    m_running = false;
+    m_succeeded = succeeded;
+    m_error = error;
+
+    // hanging up is what tells the workers to exit
+    m_server.close();
+    for (const auto &worker : m_workers)
+    {
+        worker.first->disconnect(this);
+        worker.first->disconnectFromServer();
+    }
+    m_workers.clear();
+
+    if (m_loop)
+        m_loop->quit();
+}
+
+int RenderFarm::runWorker(const QString &serverName, int threads, int crashAfter)
+{
+    QLocalSocket socket;
+    socket.connectToServer(serverName);
+    if (!socket.waitForConnected())
+        return 1;
+
+    // a worker has no event loop; it just blocks until the next message arrives
+    std::unique_ptr<BatchRenderer> renderer;
+    QRect image;
+    std::vector<float> values;
+    int finishedTiles = 0;
+    QByteArray message;
+    while (true)
+    {
+        while (!readMessage(&socket, message))
+        {
+            if (!socket.waitForReadyRead(-1))
+                return 0;
+        }
+
+        QDataStream stream{message};
+        quint8 type = 0;
+        stream >> type;
+        if (type == SetupMessage)
+        {
+            qint32 formula = 0;
+            big_float centerReal;
+            big_float centerImag;
+            qint32 maxIterations = 0;
+            big_float juliaReal;
+            big_float juliaImag;
+            BatchRenderer::Settings settings;
+            stream >> formula;
+            if (!readNumber(stream, centerReal) || !readNumber(stream, centerImag) || !readNumber(stream, settings.width))
+                return 1;
+            stream >> settings.size >> maxIterations;
+            if (!readNumber(stream, juliaReal) || !readNumber(stream, juliaImag))
+                return 1;
+            stream >> settings.deepZoom;
+            // a view the renderer can't work with is as malformed as one that didn't parse
+            if (stream.status() != QDataStream::Ok || formula < 0 || formula >= static_cast<qint32>(formulas().size()) ||
+                    settings.size.isEmpty() || maxIterations < 1 || settings.width <= 0)
+                return 1;
+
+            settings.formula = static_cast<Formula>(formula);
+            settings.center = complex{centerReal, centerImag};
+            settings.maxIterations = maxIterations;
+            settings.juliaConstant = complex{juliaReal, juliaImag};
+            settings.threads = threads;
+            image = QRect{QPoint{}, settings.size};
+            renderer = std::make_unique<BatchRenderer>(settings);
+        }
+        else if (type == TileMessage && renderer)
+        {
+            qint32 tile = -1;
+            QRect rect;
+            stream >> tile >> rect;
+            if (stream.status() != QDataStream::Ok || rect.isEmpty() || !image.contains(rect))
+                return 1;
+
+            values.resize(static_cast<size_t>(rect.width()) * rect.height());
+            QElapsedTimer timer;
+            timer.start();
+            renderer->calculate(rect, values.data());
+            const qint64 nanoseconds = timer.nsecsElapsed();
+
+            // neighbouring counts are close together and the inside of the set is all zeros, so they squeeze well
+            QByteArray result;
+            QDataStream resultStream{&result, QIODevice::WriteOnly};
+            resultStream << quint8{ResultMessage} << tile << nanoseconds
+                         << qCompress(reinterpret_cast<const uchar *>(values.data()), static_cast<int>(values.size() * sizeof(float)));
+            sendMessage(&socket, result);
+            while (socket.bytesToWrite() > 0)
+            {
+                if (!socket.waitForBytesWritten(-1))
+                    return 0;
+            }
+            // whatever tile it was sent next is lost with it, like with a real crash
+            if (++finishedTiles == crashAfter)
+                return 1;
+        }
+        else
+        {
+            return 1;
+        }
+    }
+}
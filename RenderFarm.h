@@ -0,0 +1,133 @@
+#ifndef RENDERFARM_H
+#define RENDERFARM_H
+
+#include <QElapsedTimer>
+#include <QLocalServer>
+#include <QObject>
+#include <QRect>
+#include <QRgb>
+#include <QString>
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <vector>
+
+#include "BatchRenderer.h"
+#include "Palette.h"
+
+class QEventLoop;
+class QLocalSocket;
+class QProcess;
+
+// Splits a fracture-render job across several worker processes (fracture-render --worker) and stitches their results
+// together. A worker that crashes, say on a deep tile that runs it out of memory, only costs the tiles it was working
+// on instead of the whole render.
+//
+// The coordinator listens on a local socket and starts the workers, which connect back to it. Each one gets the view
+// once, with its coordinates as exact decimal strings so deep zooms come out the same as in a single process, and
+// then tiles of the image to calculate. Tiles go back as compressed smoothed iteration counts; the coordinator colors
+// them and writes the image out band by band as in BatchRenderer::render().
+//
+// Workers get their next tile before they've finished the current one, so they never wait for the coordinator. The
+// tiles of a worker that dies go back on the queue and a new worker is started in its place. Once the queue is empty,
+// an idle worker also takes over tiles that it can finish sooner than the (measured to be slower) worker holding them;
+// whichever copy comes back first wins.
+class RenderFarm : public QObject
+{
+public:
+    struct Options
+    {
+        int workers{2};
+        // how many threads each worker renders with
+        int threadsPerWorker{1};
+        // how many workers a tile may take down with it before the render gives up
+        int maxAttempts{3};
+        // for testing: the first worker exits after calculating this many tiles, as if it had crashed, and the others
+        // (and its replacement) have to finish the ones it was holding; 0 to leave it alone
+        int crashAfter{0};
+    };
+
+    RenderFarm(const BatchRenderer::Settings &settings, const Options &options, QObject *parent = nullptr);
+    ~RenderFarm() override;
+
+    // renders the image and calls writeRow for every row of it from top to bottom, like BatchRenderer::render(). Runs
+    // an event loop until the image is done; returns false if writeRow does or the render failed, see errorString().
+    bool render(const std::function<bool(const QRgb *pixels, const float *values)> &writeRow);
+    QString errorString() const { return m_error; }
+
+    // the worker's side: connects to the coordinator listening as serverName and calculates the tiles it sends until
+    // it hangs up, or until it has calculated crashAfter of them if that's positive. Returns the exit code for the
+    // worker process.
+    static int runWorker(const QString &serverName, int threads, int crashAfter = 0);
+
+private:
+    struct Tile
+    {
+        QRect rect;
+        int band;
+        // how many workers died while they had it
+        int attempts{0};
+        // how many workers are calculating it right now
+        int owners{0};
+        bool done{false};
+    };
+
+    struct Worker
+    {
+        // the tiles it's been sent and hasn't returned yet, oldest first, along with when they were sent
+        std::deque<std::pair<int, qint64>> tiles;
+        // what it reported having calculated so far, for its throughput
+        qint64 pixels{0};
+        qint64 nanoseconds{0};
+    };
+
+    struct Band
+    {
+        std::vector<float> values;
+        int remainingTiles{0};
+    };
+
+    // crashAfter is passed on to the worker, see Options
+    void startWorker(int crashAfter = 0);
+    void workerConnected();
+    void workerDisconnected(QLocalSocket *socket);
+    void readResults(QLocalSocket *socket);
+    void tileFinished(QLocalSocket *socket, int index, qint64 nanoseconds, const QByteArray &data);
+    // keeps worker's pipeline full, and once there's nothing left to hand out, finds it a tile to take over
+    void dispatch(QLocalSocket *socket);
+    int tileToTakeOver(QLocalSocket *socket) const;
+    void sendTile(QLocalSocket *socket, int tile);
+    // writes out every finished band that's next in line; false once there's nothing more to do, because the image is
+    // done or couldn't be written
+    bool writeBands();
+    // stops the render and hangs up on the workers
+    void finish(bool succeeded, const QString &error = {});
+
+    BatchRenderer::Settings m_settings;
+    Options m_options;
+    Palette m_palette;
+    std::function<bool(const QRgb *pixels, const float *values)> m_writeRow;
+
+    QLocalServer m_server;
+    std::vector<QProcess *> m_processes;
+    // how many more crashed workers get replaced
+    int m_restartsLeft{0};
+    std::map<QLocalSocket *, Worker> m_workers;
+
+    std::vector<Tile> m_tiles;
+    // the tiles nobody has been sent yet, in the order the bands are written in
+    std::deque<int> m_queue;
+    // the bands that have tiles back; at most a few of them, starting at m_nextBand
+    std::map<int, Band> m_bands;
+    int m_nextBand{0};
+    int m_bandCount{0};
+
+    QElapsedTimer m_clock;
+    QEventLoop *m_loop{nullptr};
+    bool m_running{false};
+    bool m_succeeded{false};
+    QString m_error;
+};
+
+#endif // RENDERFARM_H
@@ -0,0 +1,295 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QTextStream>
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "BatchRenderer.h"
+#include "Formulas.h"
+#include "PngWriter.h"
+#include "RenderFarm.h"
+#include "SimdKernels.h"
+#include "ZoomAnimation.h"
+
+// fracture-render renders a single view straight to a PNG without opening a window, e.g.
+//
+//     fracture-render --real -0.743643887037151 --imag 0.13182590420533 --width 1e-10 --size 100000x100000 poster.png
+//
+// The image is streamed to disk a band of rows at a time, so it can be much bigger than the available memory. With
+// --frames it renders a zoom from --start-width down to that view instead, as numbered PNGs in the output directory:
+//
+//     fracture-render --real -0.743643887037151 --imag 0.13182590420533 --width 1e-10 --frames 600 zoom/
+//
+// --farm splits a single image across that many fracture-render --worker processes, see RenderFarm.
+
+static bool parseFormula(const QString &name, Formula &formula)
+{
+    const auto info = findFormula(name.toUtf8().constData());
+    if (!info)
+        return false;
+    formula = info->id;
+    return true;
+}
+
+static bool parseScheme(const QString &name, Palette::Scheme &scheme)
+{
+    if (name == "classic")
+        scheme = Palette::Classic;
+    else if (name == "fire")
+        scheme = Palette::Fire;
+    else if (name == "ocean")
+        scheme = Palette::Ocean;
+    else if (name == "grayscale")
+        scheme = Palette::Grayscale;
+    else
+        return false;
+    return true;
+}
+
+static bool parseNumber(const QString &text, big_float &number)
+{
+    try
+    {
+        number = parseDecimal(text.toStdString());
+        return true;
+    }
+    catch (const std::runtime_error &)
+    {
+        return false;
+    }
+}
+
+static bool parseSize(const QString &text, QSize &size)
+{
+    const auto parts = text.split('x');
+    if (parts.size() != 2)
+        return false;
+
+    bool widthOk = false;
+    bool heightOk = false;
+    size = QSize{parts[0].toInt(&widthOk), parts[1].toInt(&heightOk)};
+    return widthOk && heightOk && !size.isEmpty();
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("fracture-render");
+    QCoreApplication::setOrganizationName("Loren Burkholder");
+    QCoreApplication::setOrganizationDomain("io.github.LorenDB");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Renders a fractal to a PNG file without opening a window.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("output", "The PNG file to write, or the directory to write the frames to.");
+    // the coordinates are read as strings, so deep zooms keep every digit they were given
+    QStringList formulaNames;
+    for (const auto &formula : formulas())
+        formulaNames.push_back(formula.name);
+    const QCommandLineOption typeOption{"type", QString{"One of %1."}.arg(formulaNames.join(", ")), "type", "mandelbrot"};
+    const QCommandLineOption realOption{"real", "The real part of the point in the middle of the image.", "number", "-0.5"};
+    const QCommandLineOption imagOption{"imag", "The imaginary part of the point in the middle of the image.", "number", "0"};
+    const QCommandLineOption widthOption{"width", "How much of the real axis the image spans.", "number", "4"};
+    const QCommandLineOption sizeOption{"size", "The size of the image in pixels.", "WxH", "1920x1080"};
+    const QCommandLineOption iterationsOption{"iterations", "The iteration budget; picked from the zoom depth if left out.", "count"};
+    const QCommandLineOption juliaRealOption{"julia-real", "The real part of the Julia set's constant.", "number", "0.63982341"};
+    const QCommandLineOption juliaImagOption{"julia-imag", "The imaginary part of the Julia set's constant.", "number", "0.123432153"};
+    const QCommandLineOption schemeOption{"scheme", "classic, fire, ocean or grayscale.", "scheme", "classic"};
+    const QCommandLineOption bandedOption{"banded", "Color by whole iterations instead of smoothly."};
+    const QCommandLineOption threadsOption{"threads", "How many threads to render with.", "count", QString::number(QThread::idealThreadCount())};
+    const QCommandLineOption framesOption{"frames", "Render a zoom into the view with this many frames.", "count", "1"};
+    const QCommandLineOption startWidthOption{"start-width", "The width the zoom starts at.", "number", "4"};
+    const QCommandLineOption keyFrameScaleOption{"key-frame-scale", "How far the zoom goes on every calculated frame; the frames in "
+                                                 "between are scaled down from it.", "factor", "2"};
+    const QCommandLineOption farmOption{"farm", "Split the image across this many worker processes; --threads is then per worker.",
+                                        "count"};
+    // how the coordinator starts its workers, not meant to be typed in
+    QCommandLineOption workerOption{"worker", "Calculate tiles for the coordinator listening as server.", "server"};
+    workerOption.setFlags(QCommandLineOption::HiddenFromHelp);
+    // for the farm test, see RenderFarm::Options::crashAfter
+    QCommandLineOption crashAfterOption{"crash-after", "Make the first worker exit after calculating this many tiles.", "count"};
+    crashAfterOption.setFlags(QCommandLineOption::HiddenFromHelp);
+    parser.addOptions({typeOption, realOption, imagOption, widthOption, sizeOption, iterationsOption, juliaRealOption, juliaImagOption,
+                       schemeOption, bandedOption, threadsOption, framesOption, startWidthOption, keyFrameScaleOption, farmOption,
+                       workerOption, crashAfterOption});
+    parser.process(app);
+
+    // a worker gets everything else from the coordinator
+    if (parser.isSet(workerOption))
+        return RenderFarm::runWorker(parser.value(workerOption), std::max(parser.value(threadsOption).toInt(), 1),
+                                     parser.value(crashAfterOption).toInt());
+
+    QTextStream err{stderr};
+    auto fail = [&err](const QString &message) {
+        err << "fracture-render: " << message << "\n";
+        return 1;
+    };
+
+    if (parser.positionalArguments().size() != 1)
+        return fail("expected exactly one output file");
+
+    BatchRenderer::Settings settings;
+    if (!parseFormula(parser.value(typeOption), settings.formula))
+        return fail(QString{"unknown fractal type %1"}.arg(parser.value(typeOption)));
+    if (!parseScheme(parser.value(schemeOption), settings.scheme))
+        return fail(QString{"unknown color scheme %1"}.arg(parser.value(schemeOption)));
+    if (!parseSize(parser.value(sizeOption), settings.size))
+        return fail(QString{"invalid size %1"}.arg(parser.value(sizeOption)));
+    settings.smooth = !parser.isSet(bandedOption);
+
+    big_float real;
+    big_float imag;
+    big_float juliaReal;
+    big_float juliaImag;
+    if (!parseNumber(parser.value(realOption), real) || !parseNumber(parser.value(imagOption), imag) ||
+            !parseNumber(parser.value(widthOption), settings.width) || !parseNumber(parser.value(juliaRealOption), juliaReal) ||
+            !parseNumber(parser.value(juliaImagOption), juliaImag))
+        return fail("invalid number");
+    if (settings.width <= 0)
+        return fail("the width has to be positive");
+    settings.center = complex{real, imag};
+    settings.juliaConstant = complex{juliaReal, juliaImag};
+
+    settings.maxIterations = autoIterationBudget(settings.width);
+    if (parser.isSet(iterationsOption))
+        settings.maxIterations = parser.value(iterationsOption).toInt();
+    settings.threads = parser.value(threadsOption).toInt();
+
+    const int workers = parser.isSet(farmOption) ? parser.value(farmOption).toInt() : 0;
+    if (parser.isSet(farmOption) && workers < 1)
+        return fail("the number of workers has to be positive");
+    // the workers share the machine unless told otherwise
+    if (workers > 0 && !parser.isSet(threadsOption))
+        settings.threads = std::max(QThread::idealThreadCount() / workers, 1);
+    if (settings.maxIterations < 1 || settings.threads < 1)
+        return fail("the iterations and threads have to be positive numbers");
+
+    const int frames = parser.value(framesOption).toInt();
+    if (frames < 1)
+        return fail("the number of frames has to be positive");
+    if (frames > 1 && workers > 0)
+        return fail("--farm only renders single images");
+    if (frames > 1)
+    {
+        ZoomAnimation::Settings animationSettings;
+        animationSettings.frame = settings;
+        animationSettings.frameCount = frames;
+        animationSettings.keyFrameScale = parser.value(keyFrameScaleOption).toDouble();
+        animationSettings.autoIterations = !parser.isSet(iterationsOption);
+        if (!parseNumber(parser.value(startWidthOption), animationSettings.startWidth))
+            return fail("invalid number");
+        if (animationSettings.startWidth <= settings.width)
+            return fail("the zoom has to start wider than it ends");
+        if (animationSettings.keyFrameScale < 1)
+            return fail("the key frame scale can't be below 1");
+
+        const QDir directory{parser.positionalArguments().first()};
+        if (!directory.mkpath("."))
+            return fail(QString{"can't create %1"}.arg(directory.path()));
+
+        ZoomAnimation animation{animationSettings};
+        err << QString{"rendering %1 frames of %2x%3 from %4 key frames (%5)\n"}
+               .arg(frames)
+               .arg(settings.size.width())
+               .arg(settings.size.height())
+               .arg(animation.keyFrameCount())
+               .arg(simdInstructionSet());
+        err.flush();
+
+        QElapsedTimer timer;
+        timer.start();
+        // the frames finish on several threads at once
+        QMutex mutex;
+        int written = 0;
+        QString error;
+        const bool rendered = animation.render([&](int frame, const QImage &image) {
+            PngWriter writer;
+            bool ok = writer.open(directory.filePath(QString{"frame-%1.png"}.arg(frame, 5, 10, QChar{'0'})), image.size());
+            for (int y = 0; ok && y < image.height(); ++y)
+                ok = writer.writeRow(reinterpret_cast<const QRgb *>(image.constScanLine(y)));
+            if (!ok || !writer.close())
+            {
+                QMutexLocker locker{&mutex};
+                error = writer.errorString();
+                return false;
+            }
+
+            QMutexLocker locker{&mutex};
+            err << QString{"\r%1/%2 frames"}.arg(++written).arg(frames);
+            err.flush();
+            return true;
+        });
+        if (!rendered)
+            return fail(error);
+
+        err << QString{"\rdone in %1 s\n"}.arg(timer.elapsed() / 1000.0);
+        return 0;
+    }
+
+    PngWriter writer;
+    if (!writer.open(parser.positionalArguments().first(), settings.size))
+        return fail(writer.errorString());
+
+    QElapsedTimer timer;
+    int row = 0;
+    auto writeRow = [&](const QRgb *pixels, const float *) {
+        if (!writer.writeRow(pixels))
+            return false;
+        // a progress line every few percent is plenty, even for huge images
+        if (++row % std::max(settings.size.height() / 50, 1) == 0)
+        {
+            err << QString{"\r%1%"}.arg(row * 100 / settings.size.height());
+            err.flush();
+        }
+        return true;
+    };
+
+    bool rendered = false;
+    QString error;
+    if (workers > 0)
+    {
+        err << QString{"rendering %1x%2 at %3 iterations on %4 workers with %5 threads each\n"}
+               .arg(settings.size.width())
+               .arg(settings.size.height())
+               .arg(settings.maxIterations)
+               .arg(workers)
+               .arg(settings.threads);
+        err.flush();
+
+        RenderFarm::Options options;
+        options.workers = workers;
+        options.threadsPerWorker = settings.threads;
+        options.crashAfter = parser.value(crashAfterOption).toInt();
+        RenderFarm farm{settings, options};
+        timer.start();
+        rendered = farm.render(writeRow);
+        error = farm.errorString();
+    }
+    else
+    {
+        BatchRenderer renderer{settings};
+        QString precision = precisionName(renderer.precision());
+        if (renderer.precision() == Precision::MultiPrecision)
+            precision += QString{" with %1 digits"}.arg(renderer.digits());
+        err << QString{"rendering %1x%2 at %3 iterations in %4 (%5)\n"}
+               .arg(settings.size.width())
+               .arg(settings.size.height())
+               .arg(settings.maxIterations)
+               .arg(precision)
+               .arg(simdInstructionSet());
+        err.flush();
+
+        timer.start();
+        rendered = renderer.render(writeRow);
+    }
+    // an error of the farm's own comes first; otherwise it was the writer that failed
+    if (!rendered || !writer.close())
+        return fail(error.isEmpty() ? writer.errorString() : error);
+
+    err << QString{"\rdone in %1 s\n"}.arg(timer.elapsed() / 1000.0);
+    return 0;
+}
@@ -0,0 +1,131 @@
+#include "RenderTelemetry.h"
+
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QThread>
+
+#include <algorithm>
+
+#include "Kernels.h"
+
+RenderTelemetry::RenderTelemetry(int threadCount)
+    : m_threadCount{std::max(threadCount, 1)}
+{
+    m_timer.start();
+}
+
+RenderTelemetry::Event RenderTelemetry::start(const char *name, const QRect &tile, int pass) const
+{
+    Event event;
+    event.name = name;
+    event.tile = tile;
+    event.pass = pass;
+    event.thread = reinterpret_cast<quintptr>(QThread::currentThreadId());
+    event.start = m_timer.nsecsElapsed();
+    return event;
+}
+
+void RenderTelemetry::finish(Event &event)
+{
+    event.end = m_timer.nsecsElapsed();
+    QMutexLocker locker{&m_mutex};
+    m_events.push_back(event);
+}
+
+void RenderTelemetry::addPixels(Event &event, const float *values, int count, int maxIterations)
+{
+    event.pixels += count;
+    for (int i = 0; i < count; ++i)
+        event.iterations += iterationsSpent(values[i], maxIterations);
+}
+
+void RenderTelemetry::finishRender()
+{
+    QMutexLocker locker{&m_mutex};
+    m_end = m_timer.nsecsElapsed();
+}
+
+RenderTelemetry::Summary RenderTelemetry::summary() const
+{
+    QMutexLocker locker{&m_mutex};
+    const qint64 end = m_end < 0 ? m_timer.nsecsElapsed() : m_end;
+
+    Summary summary;
+    summary.milliseconds = end / 1e6;
+    qint64 busy = 0;
+    for (const auto &event : m_events)
+    {
+        summary.pixels += event.pixels;
+        summary.iterations += event.iterations;
+        summary.samples += event.samples;
+        // the threads of a density render are busy with their batches of orbits instead of tiles
+        if (event.pass > 0 || event.samples > 0)
+            busy += event.end - event.start;
+    }
+    if (end > 0)
+        summary.utilization = std::min(static_cast<double>(busy) / (static_cast<double>(end) * m_threadCount), 1.0);
+    return summary;
+}
+
+bool RenderTelemetry::writeTrace(const QString &fileName, QString *error) const
+{
+    QJsonArray events;
+    {
+        QMutexLocker locker{&m_mutex};
+
+        // the viewers want small thread numbers, so number the threads in the order they first show up
+        QHash<quintptr, int> threads;
+        for (const auto &event : m_events)
+        {
+            if (threads.contains(event.thread))
+                continue;
+            const int id = threads.size() + 1;
+            threads.insert(event.thread, id);
+            events.append(QJsonObject{{"name", "thread_name"},
+                                      {"ph", "M"},
+                                      {"pid", 1},
+                                      {"tid", id},
+                                      {"args", QJsonObject{{"name", QStringLiteral("worker %1").arg(id)}}}});
+        }
+
+        // complete ("X") events take their timestamps in microseconds
+        for (const auto &event : m_events)
+        {
+            QJsonObject args{{"pixels", event.pixels},
+                             {"iterations", event.iterations},
+                             {"calculatingMs", event.calculating / 1e6},
+                             {"otherMs", (event.end - event.start - event.calculating) / 1e6}};
+            if (event.samples > 0)
+                args.insert("samples", event.samples);
+            if (event.pass > 0)
+            {
+                args.insert("pass", event.pass);
+                args.insert("x", event.tile.x());
+                args.insert("y", event.tile.y());
+                args.insert("width", event.tile.width());
+                args.insert("height", event.tile.height());
+            }
+            events.append(QJsonObject{{"name", event.name},
+                                      {"cat", event.pass > 0 ? "tile" : "render"},
+                                      {"ph", "X"},
+                                      {"pid", 1},
+                                      {"tid", threads.value(event.thread)},
+                                      {"ts", event.start / 1e3},
+                                      {"dur", (event.end - event.start) / 1e3},
+                                      {"args", args}});
+        }
+    }
+
+    QSaveFile file{fileName};
+    if (!file.open(QIODevice::WriteOnly) || file.write(QJsonDocument{QJsonObject{{"traceEvents", events}}}.toJson(QJsonDocument::Compact)) < 0 ||
+            !file.commit())
+    {
+        if (error)
+            *error = file.errorString();
+        return false;
+    }
+    return true;
+}
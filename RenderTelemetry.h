@@ -0,0 +1,72 @@
+#ifndef RENDERTELEMETRY_H
+#define RENDERTELEMETRY_H
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QRect>
+#include <QString>
+
+#include <vector>
+
+// Records where the time of a render goes: one event per tile of every pass (and a few others, like the reference
+// orbit), with the thread it ran on, how long it took, how much of that was spent in the kernels and how many pixels (or
+// orbits) and iterations it calculated. A render only gets one of these when telemetry is switched on, so turning it off
+// costs a null check per tile.
+class RenderTelemetry
+{
+public:
+    struct Event
+    {
+        const char *name{nullptr};
+        QRect tile;
+        // the block size of the progressive pass the tile belonged to, or 0 for anything that isn't a tile
+        int pass{0};
+        quintptr thread{0};
+        // in nanoseconds since the render started
+        qint64 start{0};
+        qint64 end{0};
+        // the part of the event spent inside the kernels; the rest is locking, coloring and bookkeeping
+        qint64 calculating{0};
+        qint64 pixels{0};
+        qint64 iterations{0};
+        // the orbits a density render (see Buddhabrot) iterated, which don't belong to any one pixel
+        qint64 samples{0};
+    };
+
+    struct Summary
+    {
+        double milliseconds{0};
+        qint64 pixels{0};
+        qint64 iterations{0};
+        qint64 samples{0};
+        // the share of the threads' time that went into tiles rather than waiting for them
+        double utilization{0};
+    };
+
+    explicit RenderTelemetry(int threadCount);
+
+    // starts an event on the calling thread; it's only recorded once it gets handed to finish()
+    Event start(const char *name, const QRect &tile = {}, int pass = 0) const;
+    void finish(Event &event);
+    // adds a run of calculated pixels, given their smoothed iteration counts, to event
+    static void addPixels(Event &event, const float *values, int count, int maxIterations);
+
+    // marks the end of the render; the summary covers the time up to here
+    void finishRender();
+    Summary summary() const;
+
+    // writes the events in the Trace Event Format, which chrome://tracing and Perfetto can open
+    bool writeTrace(const QString &fileName, QString *error = nullptr) const;
+
+    qint64 elapsed() const { return m_timer.nsecsElapsed(); }
+
+private:
+    int m_threadCount;
+    QElapsedTimer m_timer;
+    qint64 m_end{-1};
+
+    mutable QMutex m_mutex;
+    std::vector<Event> m_events;
+};
+
+#endif // RENDERTELEMETRY_H
@@ -0,0 +1,330 @@
+#include "SimdKernels.h"
+
+#include "Formulas.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define FRACTURE_SIMD_X86
+#include <immintrin.h>
+#endif
+
+// All the vector kernels follow the same pattern as the scalar ones: every lane iterates its own point, and once a
+// lane escapes it gets its iteration count written and is masked out. The whole vector only stops once every lane has
+// either escaped or run out of iterations. The arithmetic is done in exactly the same order as in Kernels.h (and
+// without fused multiply-adds) so the results don't depend on which kernel ends up running. That includes the
+// cardioid/bulb shortcut and the periodicity check, which mark lanes as done (with 0 iterations) just like the scalar
+// kernels return early.
+
+namespace
+{
+
+using PointsKernel = void (*)(Formula, const double *, const double *, double, double, int, double, int, float *,
+                              const std::atomic<bool> *);
+
+// the vector kernels only track the iteration count and |z|^2 at escape per lane; the smoothing is done afterwards
+void storeResults(const int *iterations, const double *magnitudes, int lanes, float *results)
+{
+    for (int lane = 0; lane < lanes; ++lane)
+        results[lane] = iterations[lane] == 0 ? 0 : smoothIterations(iterations[lane], magnitudes[lane]);
+}
+
+void calculatePointsScalar(Formula formula, const double *real, const double *imag, double juliaReal, double juliaImag,
+                           int maxIterations, double periodTolerance, int count, float *results, const std::atomic<bool> *cancelled)
+{
+    const KernelParameters<double> parameters{juliaReal, juliaImag, maxIterations, periodTolerance};
+    visitFormula(formula, [&](auto kernel) {
+        for (int n = 0; n < count; ++n)
+            results[n] = kernel.calculatePoint(real[n], imag[n], parameters, cancelled);
+    });
+}
+
+#ifdef FRACTURE_SIMD_X86
+
+void calculatePointsSse2(Formula formula, const double *real, const double *imag, double juliaReal, double juliaImag,
+                         int maxIterations, double periodTolerance, int count, float *results, const std::atomic<bool> *cancelled)
+{
+    const __m128d four = _mm_set1_pd(4);
+    const __m128d two = _mm_set1_pd(2);
+    const __m128d signMask = _mm_set1_pd(-0.0);
+    const __m128d tolerance = _mm_set1_pd(periodTolerance);
+    const bool burningShip = formula == Formula::BurningShip;
+
+    int n = 0;
+    for (; n + 2 <= count; n += 2)
+    {
+        const __m128d pointReal = _mm_loadu_pd(real + n);
+        const __m128d pointImag = _mm_loadu_pd(imag + n);
+        __m128d zReal = burningShip ? _mm_andnot_pd(signMask, pointReal) : pointReal;
+        __m128d zImag = burningShip ? _mm_andnot_pd(signMask, pointImag) : pointImag;
+        const __m128d kReal = formula == Formula::Julia ? _mm_set1_pd(juliaReal) : pointReal;
+        const __m128d kImag = formula == Formula::Julia ? _mm_set1_pd(juliaImag) : pointImag;
+
+        const __m128d initialMagnitude = _mm_add_pd(_mm_mul_pd(zReal, zReal), _mm_mul_pd(zImag, zImag));
+        __m128d done = _mm_cmpgt_pd(initialMagnitude, four);
+        __m128d iterations = _mm_and_pd(done, _mm_set1_pd(1));
+        __m128d escapeMagnitude = _mm_and_pd(done, initialMagnitude);
+
+        if (formula == Formula::Mandelbrot)
+        {
+            const __m128d imag2 = _mm_mul_pd(pointImag, pointImag);
+            const __m128d shifted = _mm_sub_pd(pointReal, _mm_set1_pd(0.25));
+            const __m128d q = _mm_add_pd(_mm_mul_pd(shifted, shifted), imag2);
+            const __m128d cardioid = _mm_cmple_pd(_mm_mul_pd(q, _mm_add_pd(q, shifted)), _mm_mul_pd(imag2, _mm_set1_pd(0.25)));
+            const __m128d bulbReal = _mm_add_pd(pointReal, _mm_set1_pd(1));
+            const __m128d bulb = _mm_cmple_pd(_mm_add_pd(_mm_mul_pd(bulbReal, bulbReal), imag2), _mm_set1_pd(0.0625));
+            done = _mm_or_pd(done, _mm_or_pd(cardioid, bulb));
+        }
+
+        __m128d savedReal = zReal;
+        __m128d savedImag = zImag;
+        int steps = 0;
+        int period = 1;
+        for (int i = 0; i < maxIterations && _mm_movemask_pd(done) != 0x3; ++i)
+        {
+            if (isCancelled(cancelled, i))
+                return;
+
+            const __m128d temp = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(zReal, zReal), _mm_mul_pd(zImag, zImag)), kReal);
+            zImag = _mm_add_pd(_mm_mul_pd(_mm_mul_pd(two, zReal), zImag), kImag);
+            zReal = temp;
+            if (burningShip)
+            {
+                zReal = _mm_andnot_pd(signMask, zReal);
+                zImag = _mm_andnot_pd(signMask, zImag);
+            }
+
+            const __m128d magnitude = _mm_add_pd(_mm_mul_pd(zReal, zReal), _mm_mul_pd(zImag, zImag));
+            const __m128d escaped = _mm_andnot_pd(done, _mm_cmpgt_pd(magnitude, four));
+            iterations = _mm_or_pd(iterations, _mm_and_pd(escaped, _mm_set1_pd(i + 1)));
+            escapeMagnitude = _mm_or_pd(escapeMagnitude, _mm_and_pd(escaped, magnitude));
+            done = _mm_or_pd(done, escaped);
+
+            const __m128d realDistance = _mm_sub_pd(zReal, savedReal);
+            const __m128d imagDistance = _mm_sub_pd(zImag, savedImag);
+            const __m128d distance = _mm_add_pd(_mm_mul_pd(realDistance, realDistance), _mm_mul_pd(imagDistance, imagDistance));
+            done = _mm_or_pd(done, _mm_cmplt_pd(distance, tolerance));
+            if (++steps == period)
+            {
+                savedReal = zReal;
+                savedImag = zImag;
+                steps = 0;
+                period *= 2;
+            }
+        }
+
+        alignas(16) int laneIterations[4];
+        alignas(16) double laneMagnitudes[2];
+        _mm_store_si128(reinterpret_cast<__m128i *>(laneIterations), _mm_cvtpd_epi32(iterations));
+        _mm_store_pd(laneMagnitudes, escapeMagnitude);
+        storeResults(laneIterations, laneMagnitudes, 2, results + n);
+    }
+
+    calculatePointsScalar(formula, real + n, imag + n, juliaReal, juliaImag, maxIterations, periodTolerance, count - n, results + n,
+                          cancelled);
+}
+
+__attribute__((target("avx2")))
+void calculatePointsAvx2(Formula formula, const double *real, const double *imag, double juliaReal, double juliaImag,
+                         int maxIterations, double periodTolerance, int count, float *results, const std::atomic<bool> *cancelled)
+{
+    const __m256d four = _mm256_set1_pd(4);
+    const __m256d two = _mm256_set1_pd(2);
+    const __m256d signMask = _mm256_set1_pd(-0.0);
+    const __m256d tolerance = _mm256_set1_pd(periodTolerance);
+    const bool burningShip = formula == Formula::BurningShip;
+
+    int n = 0;
+    for (; n + 4 <= count; n += 4)
+    {
+        const __m256d pointReal = _mm256_loadu_pd(real + n);
+        const __m256d pointImag = _mm256_loadu_pd(imag + n);
+        __m256d zReal = burningShip ? _mm256_andnot_pd(signMask, pointReal) : pointReal;
+        __m256d zImag = burningShip ? _mm256_andnot_pd(signMask, pointImag) : pointImag;
+        const __m256d kReal = formula == Formula::Julia ? _mm256_set1_pd(juliaReal) : pointReal;
+        const __m256d kImag = formula == Formula::Julia ? _mm256_set1_pd(juliaImag) : pointImag;
+
+        const __m256d initialMagnitude = _mm256_add_pd(_mm256_mul_pd(zReal, zReal), _mm256_mul_pd(zImag, zImag));
+        __m256d done = _mm256_cmp_pd(initialMagnitude, four, _CMP_GT_OQ);
+        __m256d iterations = _mm256_and_pd(done, _mm256_set1_pd(1));
+        __m256d escapeMagnitude = _mm256_and_pd(done, initialMagnitude);
+
+        if (formula == Formula::Mandelbrot)
+        {
+            const __m256d imag2 = _mm256_mul_pd(pointImag, pointImag);
+            const __m256d shifted = _mm256_sub_pd(pointReal, _mm256_set1_pd(0.25));
+            const __m256d q = _mm256_add_pd(_mm256_mul_pd(shifted, shifted), imag2);
+            const __m256d cardioid = _mm256_cmp_pd(_mm256_mul_pd(q, _mm256_add_pd(q, shifted)), _mm256_mul_pd(imag2, _mm256_set1_pd(0.25)), _CMP_LE_OQ);
+            const __m256d bulbReal = _mm256_add_pd(pointReal, _mm256_set1_pd(1));
+            const __m256d bulb = _mm256_cmp_pd(_mm256_add_pd(_mm256_mul_pd(bulbReal, bulbReal), imag2), _mm256_set1_pd(0.0625), _CMP_LE_OQ);
+            done = _mm256_or_pd(done, _mm256_or_pd(cardioid, bulb));
+        }
+
+        __m256d savedReal = zReal;
+        __m256d savedImag = zImag;
+        int steps = 0;
+        int period = 1;
+        for (int i = 0; i < maxIterations && _mm256_movemask_pd(done) != 0xf; ++i)
+        {
+            if (isCancelled(cancelled, i))
+                return;
+
+            const __m256d temp = _mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(zReal, zReal), _mm256_mul_pd(zImag, zImag)), kReal);
+            zImag = _mm256_add_pd(_mm256_mul_pd(_mm256_mul_pd(two, zReal), zImag), kImag);
+            zReal = temp;
+            if (burningShip)
+            {
+                zReal = _mm256_andnot_pd(signMask, zReal);
+                zImag = _mm256_andnot_pd(signMask, zImag);
+            }
+
+            const __m256d magnitude = _mm256_add_pd(_mm256_mul_pd(zReal, zReal), _mm256_mul_pd(zImag, zImag));
+            const __m256d escaped = _mm256_andnot_pd(done, _mm256_cmp_pd(magnitude, four, _CMP_GT_OQ));
+            iterations = _mm256_blendv_pd(iterations, _mm256_set1_pd(i + 1), escaped);
+            escapeMagnitude = _mm256_blendv_pd(escapeMagnitude, magnitude, escaped);
+            done = _mm256_or_pd(done, escaped);
+
+            const __m256d realDistance = _mm256_sub_pd(zReal, savedReal);
+            const __m256d imagDistance = _mm256_sub_pd(zImag, savedImag);
+            const __m256d distance = _mm256_add_pd(_mm256_mul_pd(realDistance, realDistance), _mm256_mul_pd(imagDistance, imagDistance));
+            done = _mm256_or_pd(done, _mm256_cmp_pd(distance, tolerance, _CMP_LT_OQ));
+            if (++steps == period)
+            {
+                savedReal = zReal;
+                savedImag = zImag;
+                steps = 0;
+                period *= 2;
+            }
+        }
+
+        alignas(16) int laneIterations[4];
+        alignas(32) double laneMagnitudes[4];
+        _mm_store_si128(reinterpret_cast<__m128i *>(laneIterations), _mm256_cvtpd_epi32(iterations));
+        _mm256_store_pd(laneMagnitudes, escapeMagnitude);
+        storeResults(laneIterations, laneMagnitudes, 4, results + n);
+    }
+
+    calculatePointsSse2(formula, real + n, imag + n, juliaReal, juliaImag, maxIterations, periodTolerance, count - n, results + n,
+                          cancelled);
+}
+
+__attribute__((target("avx512f")))
+void calculatePointsAvx512(Formula formula, const double *real, const double *imag, double juliaReal, double juliaImag,
+                           int maxIterations, double periodTolerance, int count, float *results, const std::atomic<bool> *cancelled)
+{
+    const __m512d four = _mm512_set1_pd(4);
+    const __m512d two = _mm512_set1_pd(2);
+    const __m512d tolerance = _mm512_set1_pd(periodTolerance);
+    const bool burningShip = formula == Formula::BurningShip;
+
+    int n = 0;
+    for (; n + 8 <= count; n += 8)
+    {
+        const __m512d pointReal = _mm512_loadu_pd(real + n);
+        const __m512d pointImag = _mm512_loadu_pd(imag + n);
+        __m512d zReal = burningShip ? _mm512_abs_pd(pointReal) : pointReal;
+        __m512d zImag = burningShip ? _mm512_abs_pd(pointImag) : pointImag;
+        const __m512d kReal = formula == Formula::Julia ? _mm512_set1_pd(juliaReal) : pointReal;
+        const __m512d kImag = formula == Formula::Julia ? _mm512_set1_pd(juliaImag) : pointImag;
+
+        const __m512d initialMagnitude = _mm512_add_pd(_mm512_mul_pd(zReal, zReal), _mm512_mul_pd(zImag, zImag));
+        __mmask8 done = _mm512_cmp_pd_mask(initialMagnitude, four, _CMP_GT_OQ);
+        __m512d iterations = _mm512_maskz_mov_pd(done, _mm512_set1_pd(1));
+        __m512d escapeMagnitude = _mm512_maskz_mov_pd(done, initialMagnitude);
+
+        if (formula == Formula::Mandelbrot)
+        {
+            const __m512d imag2 = _mm512_mul_pd(pointImag, pointImag);
+            const __m512d shifted = _mm512_sub_pd(pointReal, _mm512_set1_pd(0.25));
+            const __m512d q = _mm512_add_pd(_mm512_mul_pd(shifted, shifted), imag2);
+            const __mmask8 cardioid = _mm512_cmp_pd_mask(_mm512_mul_pd(q, _mm512_add_pd(q, shifted)), _mm512_mul_pd(imag2, _mm512_set1_pd(0.25)), _CMP_LE_OQ);
+            const __m512d bulbReal = _mm512_add_pd(pointReal, _mm512_set1_pd(1));
+            const __mmask8 bulb = _mm512_cmp_pd_mask(_mm512_add_pd(_mm512_mul_pd(bulbReal, bulbReal), imag2), _mm512_set1_pd(0.0625), _CMP_LE_OQ);
+            done |= cardioid | bulb;
+        }
+
+        __m512d savedReal = zReal;
+        __m512d savedImag = zImag;
+        int steps = 0;
+        int period = 1;
+        for (int i = 0; i < maxIterations && done != 0xff; ++i)
+        {
+            if (isCancelled(cancelled, i))
+                return;
+
+            const __m512d temp = _mm512_add_pd(_mm512_sub_pd(_mm512_mul_pd(zReal, zReal), _mm512_mul_pd(zImag, zImag)), kReal);
+            zImag = _mm512_add_pd(_mm512_mul_pd(_mm512_mul_pd(two, zReal), zImag), kImag);
+            zReal = temp;
+            if (burningShip)
+            {
+                zReal = _mm512_abs_pd(zReal);
+                zImag = _mm512_abs_pd(zImag);
+            }
+
+            const __m512d magnitude = _mm512_add_pd(_mm512_mul_pd(zReal, zReal), _mm512_mul_pd(zImag, zImag));
+            const __mmask8 escaped = _mm512_mask_cmp_pd_mask(static_cast<__mmask8>(~done), magnitude, four, _CMP_GT_OQ);
+            iterations = _mm512_mask_mov_pd(iterations, escaped, _mm512_set1_pd(i + 1));
+            escapeMagnitude = _mm512_mask_mov_pd(escapeMagnitude, escaped, magnitude);
+            done |= escaped;
+
+            const __m512d realDistance = _mm512_sub_pd(zReal, savedReal);
+            const __m512d imagDistance = _mm512_sub_pd(zImag, savedImag);
+            const __m512d distance = _mm512_add_pd(_mm512_mul_pd(realDistance, realDistance), _mm512_mul_pd(imagDistance, imagDistance));
+            done |= _mm512_cmp_pd_mask(distance, tolerance, _CMP_LT_OQ);
+            if (++steps == period)
+            {
+                savedReal = zReal;
+                savedImag = zImag;
+                steps = 0;
+                period *= 2;
+            }
+        }
+
+        alignas(32) int laneIterations[8];
+        alignas(64) double laneMagnitudes[8];
+        _mm256_store_si256(reinterpret_cast<__m256i *>(laneIterations), _mm512_cvtpd_epi32(iterations));
+        _mm512_store_pd(laneMagnitudes, escapeMagnitude);
+        storeResults(laneIterations, laneMagnitudes, 8, results + n);
+    }
+
+    calculatePointsAvx2(formula, real + n, imag + n, juliaReal, juliaImag, maxIterations, periodTolerance, count - n, results + n,
+                          cancelled);
+}
+
+#endif // FRACTURE_SIMD_X86
+
+struct Dispatch
+{
+    PointsKernel kernel;
+    const char *name;
+};
+
+const Dispatch &dispatch()
+{
+    static const Dispatch selected = [] {
+#ifdef FRACTURE_SIMD_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f"))
+            return Dispatch{calculatePointsAvx512, "AVX-512"};
+        if (__builtin_cpu_supports("avx2"))
+            return Dispatch{calculatePointsAvx2, "AVX2"};
+        return Dispatch{calculatePointsSse2, "SSE2"};
+#else
+        return Dispatch{calculatePointsScalar, "scalar"};
+#endif
+    }();
+    return selected;
+}
+
+} // namespace
+
+void calculatePoints(Formula formula, const double *real, const double *imag, double juliaReal, double juliaImag, int maxIterations,
+                     double periodTolerance, int count, float *results, const std::atomic<bool> *cancelled)
+{
+    // only some of the formulas have vector kernels; the rest always take the scalar one
+    const PointsKernel kernel = formulaInfo(formula).vectorized ? dispatch().kernel : calculatePointsScalar;
+    kernel(formula, real, imag, juliaReal, juliaImag, maxIterations, periodTolerance, count, results, cancelled);
+}
+
+const char *simdInstructionSet()
+{
+    return dispatch().name;
+}
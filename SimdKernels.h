@@ -0,0 +1,21 @@
+#ifndef SIMDKERNELS_H
+#define SIMDKERNELS_H
+
+#include <atomic>
+
+#include "Common.h"
+
+// Vectorized double precision versions of the kernels in Kernels.h. These iterate several points at once (8 with
+// AVX-512, 4 with AVX2, 2 with SSE2) and give exactly the same iteration counts as the scalar double kernels; the
+// widest instruction set the CPU supports is picked at runtime.
+
+// calculates the smoothed iteration counts of count points, whose coordinates are given by real and imag, into results;
+// maxIterations, periodTolerance and cancelled mean the same as for the kernels in Kernels.h. Formulas that don't have
+// vector kernels (see FormulaInfo::vectorized) get their scalar double kernel.
+void calculatePoints(Formula formula, const double *real, const double *imag, double juliaReal, double juliaImag, int maxIterations,
+                     double periodTolerance, int count, float *results, const std::atomic<bool> *cancelled = nullptr);
+
+// the name of the instruction set calculatePoints() ended up using
+const char *simdInstructionSet();
+
+#endif // SIMDKERNELS_H
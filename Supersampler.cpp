@@ -0,0 +1,205 @@
+#include "Supersampler.h"
+
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include "Formulas.h"
+#include "SimdKernels.h"
+
+// the R2 sequence (the 2D take on the golden ratio) spreads any number of samples evenly over a pixel; these are its
+// steps along each axis
+constexpr double sequenceStepX = 0.7548776662466927;
+constexpr double sequenceStepY = 0.5698402909980532;
+
+// a cheap but well mixed hash of the pixel's position, so every pixel shifts the sequence by a different amount (and
+// neighbours don't share a sample pattern) while exporting the same view twice still gives the same image
+static double pixelShift(int x, int y, std::uint32_t salt)
+{
+    std::uint32_t hash = static_cast<std::uint32_t>(x) * 0x9e3779b1u ^ static_cast<std::uint32_t>(y) * 0x85ebca77u ^ salt;
+    hash ^= hash >> 16;
+    hash *= 0x7feb352du;
+    hash ^= hash >> 15;
+    hash *= 0x846ca68bu;
+    hash ^= hash >> 16;
+    return hash / 4294967296.0;
+}
+
+Supersampler::Supersampler(const FractalRect &view, const Settings &settings)
+    : m_view{view},
+      m_settings{settings},
+      m_precision{view.requiredPrecision()},
+      m_spacing{view.width() / view.visualRect().width()}
+{
+    // the same digits as the render the samples go into; see FractalView::updatePolish()
+    m_view.setPrecision(m_view.requiredDigits());
+    PrecisionGuard precisionGuard{m_view.precision()};
+
+    if (usesPerturbation(m_settings.formula, m_settings.deepZoom, m_precision))
+        m_perturbation = std::make_unique<ViewPerturbation>(m_view, m_settings.formula, m_settings.juliaConstant,
+                                                            m_settings.maxIterations);
+}
+
+int Supersampler::antialias(const float *values, const Palette &palette, QImage &image) const
+{
+    const int width = image.width();
+    const int height = image.height();
+    const int extraSamples = m_settings.samples - 1;
+    if (extraSamples < 1 || width < 1 || height < 1)
+        return 0;
+
+    // an edge gets sampled from both sides; pixels that never got calculated (the render was stopped) are left alone
+    std::vector<bool> needsSamples(static_cast<size_t>(width) * height);
+    auto compare = [&](size_t first, size_t second) {
+        if (values[first] == Palette::notCalculated || values[second] == Palette::notCalculated)
+            return;
+        // interior points are 0, so the edge of the set always counts
+        if (std::abs(values[first] - values[second]) > m_settings.threshold)
+            needsSamples[first] = needsSamples[second] = true;
+    };
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            const size_t index = static_cast<size_t>(y) * width + x;
+            if (x + 1 < width)
+                compare(index, index + 1);
+            if (y + 1 < height)
+                compare(index, index + width);
+        }
+    }
+
+    QVector<int> rows;
+    for (int y = 0; y < height; ++y)
+        if (std::any_of(needsSamples.begin() + static_cast<size_t>(y) * width, needsSamples.begin() + static_cast<size_t>(y + 1) * width,
+                        [](bool needed) { return needed; }))
+            rows.push_back(y);
+
+    // bits() detaches the image if it has to; doing that up front means the rows can be written in parallel
+    auto pixels = image.bits();
+    const auto bytesPerLine = image.bytesPerLine();
+    std::atomic<int> sampledPixels{0};
+    QtConcurrent::blockingMap(rows, [&](int row) {
+        PrecisionGuard precisionGuard{m_view.precision()};
+        std::vector<int> columns;
+        for (int x = 0; x < width; ++x)
+            if (needsSamples[static_cast<size_t>(row) * width + x])
+                columns.push_back(x);
+
+        // the kernels put a pixel's own sample at its integer coordinates, so the extra ones go up to half a pixel
+        // either side of that
+        const size_t count = columns.size() * extraSamples;
+        std::vector<double> xs(count);
+        std::vector<double> ys(count);
+        for (size_t i = 0; i < columns.size(); ++i)
+        {
+            const double shiftX = pixelShift(columns[i], row, 0);
+            const double shiftY = pixelShift(columns[i], row, 0x5bd1e995u);
+            for (int sample = 0; sample < extraSamples; ++sample)
+            {
+                const double sampleX = shiftX + (sample + 1) * sequenceStepX;
+                const double sampleY = shiftY + (sample + 1) * sequenceStepY;
+                xs[i * extraSamples + sample] = columns[i] + (sampleX - std::floor(sampleX)) - 0.5;
+                ys[i * extraSamples + sample] = row + (sampleY - std::floor(sampleY)) - 0.5;
+            }
+        }
+        std::vector<float> results(count);
+        calculate(xs.data(), ys.data(), static_cast<int>(count), results.data());
+
+        auto line = reinterpret_cast<QRgb *>(pixels + row * bytesPerLine);
+        for (size_t i = 0; i < columns.size(); ++i)
+        {
+            const QRgb own = palette.color(values[static_cast<size_t>(row) * width + columns[i]]);
+            int red = qRed(own);
+            int green = qGreen(own);
+            int blue = qBlue(own);
+            for (int sample = 0; sample < extraSamples; ++sample)
+            {
+                const QRgb color = palette.color(results[i * extraSamples + sample]);
+                red += qRed(color);
+                green += qGreen(color);
+                blue += qBlue(color);
+            }
+            const int samples = extraSamples + 1;
+            line[columns[i]] = qRgb((red + samples / 2) / samples, (green + samples / 2) / samples, (blue + samples / 2) / samples);
+        }
+        sampledPixels += static_cast<int>(columns.size());
+    });
+
+    return sampledPixels;
+}
+
+void Supersampler::calculate(const double *x, const double *y, int count, float *results) const
+{
+    if (m_perturbation)
+        m_perturbation->visit([&](const auto &perturbation, const auto &spacing) {
+            calculatePerturbed(perturbation, spacing, x, y, count, results);
+        });
+    else
+    {
+        switch (m_precision)
+        {
+        case Precision::Double:
+            calculateDirect<double>(x, y, count, results);
+            break;
+        case Precision::LongDouble:
+            calculateDirect<long double>(x, y, count, results);
+            break;
+#ifdef FRACTURE_HAS_FLOAT128
+        case Precision::Float128:
+            calculateDirect<__float128>(x, y, count, results);
+            break;
+#endif
+        default:
+            calculateDirect<big_float>(x, y, count, results);
+            break;
+        }
+    }
+}
+
+template<typename T>
+void Supersampler::calculateDirect(const double *x, const double *y, int count, float *results) const
+{
+    // the same mapping as FractalView::renderDirectFragment(), just at fractional pixels
+    const auto origin = m_view.getFractalValueFromVisualPoint(0, 0);
+    const T originReal = scalar_cast<T>(origin.real());
+    const T originImag = scalar_cast<T>(origin.imag());
+    const T stepReal = scalar_cast<T>(m_spacing);
+    const T stepImag = scalar_cast<T>(big_float{m_view.height() / m_view.visualRect().height()});
+    const KernelParameters<T> parameters{scalar_cast<T>(m_settings.juliaConstant.real()), scalar_cast<T>(m_settings.juliaConstant.imag()),
+                                         m_settings.maxIterations, periodTolerance(stepReal)};
+
+    if constexpr (std::is_same_v<T, double>)
+    {
+        std::vector<double> reals(count);
+        std::vector<double> imags(count);
+        for (int i = 0; i < count; ++i)
+        {
+            reals[i] = originReal + stepReal * x[i];
+            imags[i] = originImag + stepImag * y[i];
+        }
+        calculatePoints(m_settings.formula, reals.data(), imags.data(), parameters.juliaReal, parameters.juliaImag, parameters.maxIterations,
+                        parameters.periodTolerance, count, results);
+    }
+    else
+    {
+        visitFormula(m_settings.formula, [&](auto formula) {
+            for (int i = 0; i < count; ++i)
+                results[i] = formula.calculatePoint(T{originReal + stepReal * x[i]}, T{originImag + stepImag * y[i]}, parameters);
+        });
+    }
+}
+
+template<typename D>
+void Supersampler::calculatePerturbed(const Perturbation<D> &perturbation, const D &spacing, const double *x, const double *y, int count,
+                                      float *results) const
+{
+    const QPointF &referencePixel = m_perturbation->referencePixel();
+    for (int i = 0; i < count; ++i)
+        results[i] = perturbation.calculatePoint((x[i] - referencePixel.x()) * spacing, (y[i] - referencePixel.y()) * spacing);
+}
@@ -0,0 +1,59 @@
+#ifndef SUPERSAMPLER_H
+#define SUPERSAMPLER_H
+
+#include <QImage>
+
+#include <memory>
+
+#include "Common.h"
+#include "FractalRect.h"
+#include "Kernels.h"
+#include "Palette.h"
+#include "Perturbation.h"
+
+// Anti-aliases a finished render for export. Taking 16 samples of every pixel would cost 16 times as much as the render
+// itself, but most of an image is smooth gradient that looks the same at any sample count; the jaggies are where
+// neighbouring pixels escape at very different iterations. So only the pixels whose iteration count is more than a
+// threshold away from one of their neighbours get extra samples, spread across the pixel, and end up with the average
+// of their colors.
+class Supersampler
+{
+public:
+    struct Settings
+    {
+        Formula formula{Formula::Mandelbrot};
+        complex juliaConstant;
+        int maxIterations{defaultMaxIterations};
+        // track the samples as offsets from a reference orbit once the view needs more precision than long double
+        bool deepZoom{true};
+        // the most samples a pixel gets, counting the one it already has
+        int samples{16};
+        // how many iterations apart neighbouring pixels have to be for both of them to get extra samples
+        float threshold{1};
+    };
+
+    Supersampler(const FractalRect &view, const Settings &settings);
+
+    // image is a render of the view, colored with palette from the smoothed iteration counts in values; every pixel
+    // that needs it gets replaced by its supersampled color. Returns how many pixels that was.
+    int antialias(const float *values, const Palette &palette, QImage &image) const;
+
+private:
+    // calculates the smoothed iteration counts of count points, which are given in (fractional) pixels of the view
+    void calculate(const double *x, const double *y, int count, float *results) const;
+    template<typename T>
+    void calculateDirect(const double *x, const double *y, int count, float *results) const;
+    template<typename D>
+    void calculatePerturbed(const Perturbation<D> &perturbation, const D &spacing, const double *x, const double *y, int count,
+                            float *results) const;
+
+    FractalRect m_view;
+    Settings m_settings;
+    Precision m_precision;
+
+    big_float m_spacing;
+    // deep zooms only
+    std::unique_ptr<ViewPerturbation> m_perturbation;
+};
+
+#endif // SUPERSAMPLER_H
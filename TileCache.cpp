@@ -0,0 +1,153 @@
+#include "TileCache.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <limits>
+
+// bump this whenever the kernels change what they return, so that tiles from older builds stop being found
+constexpr int cacheVersion = 2;
+// every file starts with this, followed by the version and the size of the tile
+constexpr quint32 fileMagic = 0x46545443; // "FTTC"
+
+TileCache::TileCache(qint64 memoryBytes, qint64 diskBytes, const QString &directory)
+    : m_directory{directory},
+      m_diskBytes{diskBytes},
+      m_memory{static_cast<int>(std::min<qint64>(memoryBytes / 1024, std::numeric_limits<int>::max()))}
+{
+    if (m_directory.isEmpty() || !QDir{}.mkpath(m_directory))
+    {
+        m_directory.clear();
+        return;
+    }
+
+    // listing the folder can take a while once it's full, so don't hold up the first render with it
+    m_trimming = QtConcurrent::run([this] { trimDisk(); });
+}
+
+TileCache::~TileCache()
+{
+    m_trimming.waitForFinished();
+}
+
+QString TileCache::defaultDirectory()
+{
+    const auto location = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    return location.isEmpty() ? QString{} : location + "/tiles";
+}
+
+QByteArray TileCache::hash(const Key &key)
+{
+    const auto &visualRect = key.view.visualRect();
+    const auto corner = key.view.getFractalValueFromVisualPoint(key.tile.left(), key.tile.top());
+
+    QByteArray text;
+    text += QByteArray::number(cacheVersion) + ' ' + QByteArray::number(static_cast<int>(key.formula)) + ' ' +
+            QByteArray::number(key.maxIterations) + ' ' + QByteArray::number(key.tile.width()) + 'x' +
+            QByteArray::number(key.tile.height()) + ' ' + key.variant + ' ';
+    text += exactString(corner.real()) + ' ' + exactString(corner.imag()) + ' ';
+    text += exactString(big_float{key.view.width() / visualRect.width()}) + ' ' +
+            exactString(big_float{key.view.height() / visualRect.height()});
+    if (key.formula == Formula::Julia)
+        text += ' ' + exactString(key.juliaConstant.real()) + ' ' + exactString(key.juliaConstant.imag());
+    return QCryptographicHash::hash(text, QCryptographicHash::Sha1).toHex();
+}
+
+bool TileCache::find(const QByteArray &hash, const QSize &size, std::vector<float> &values)
+{
+    const auto count = static_cast<size_t>(size.width()) * size.height();
+    {
+        QMutexLocker locker{&m_mutex};
+        if (const auto tile = m_memory.object(hash); tile && tile->size() == count)
+        {
+            values = *tile;
+            return true;
+        }
+    }
+
+    if (m_directory.isEmpty())
+        return false;
+
+    QFile file{fileName(hash)};
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream stream{&file};
+    quint32 magic = 0;
+    qint32 version = 0;
+    qint32 width = 0;
+    qint32 height = 0;
+    stream >> magic >> version >> width >> height;
+    if (magic != fileMagic || version != cacheVersion || width != size.width() || height != size.height())
+        return false;
+
+    values.resize(count);
+    const auto bytes = static_cast<qint64>(count * sizeof(float));
+    if (stream.readRawData(reinterpret_cast<char *>(values.data()), bytes) != bytes)
+        return false;
+
+    // it's likely to be wanted again soon, e.g. when switching back and forth between two views
+    QMutexLocker locker{&m_mutex};
+    m_memory.insert(hash, new std::vector<float>{values}, static_cast<int>(bytes / 1024) + 1);
+    return true;
+}
+
+void TileCache::insert(const QByteArray &hash, const QSize &size, const std::vector<float> &values)
+{
+    const auto bytes = static_cast<qint64>(values.size() * sizeof(float));
+    {
+        QMutexLocker locker{&m_mutex};
+        // a tile that came out of the cache gets stored again once it's done; that only needs to bump it in the LRU
+        if (m_memory.object(hash))
+            return;
+        m_memory.insert(hash, new std::vector<float>{values}, static_cast<int>(bytes / 1024) + 1);
+    }
+
+    if (m_directory.isEmpty() || QFile::exists(fileName(hash)))
+        return;
+
+    // QSaveFile writes to a temporary file and renames it once it's complete, so a reader never sees half a tile
+    QSaveFile file{fileName(hash)};
+    if (!file.open(QIODevice::WriteOnly))
+        return;
+    QDataStream stream{&file};
+    stream << fileMagic << qint32{cacheVersion} << qint32{size.width()} << qint32{size.height()};
+    stream.writeRawData(reinterpret_cast<const char *>(values.data()), static_cast<int>(bytes));
+    if (!file.commit())
+        return;
+
+    // a long session can write a lot of tiles, so every so often the budget gets enforced again
+    if ((m_written += bytes) > m_diskBytes / 4)
+    {
+        QMutexLocker locker{&m_mutex};
+        if (m_trimming.isFinished())
+        {
+            m_written = 0;
+            m_trimming = QtConcurrent::run([this] { trimDisk(); });
+        }
+    }
+}
+
+QString TileCache::fileName(const QByteArray &hash) const
+{
+    return m_directory + '/' + QString::fromLatin1(hash);
+}
+
+void TileCache::trimDisk()
+{
+    // newest first, so everything past the point where the budget runs out goes
+    const auto files = QDir{m_directory}.entryInfoList(QDir::Files, QDir::Time);
+    qint64 total = 0;
+    for (const auto &file : files)
+    {
+        total += file.size();
+        if (total > m_diskBytes)
+            QFile::remove(file.filePath());
+    }
+}
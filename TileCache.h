@@ -0,0 +1,69 @@
+#ifndef TILECACHE_H
+#define TILECACHE_H
+
+#include <QByteArray>
+#include <QCache>
+#include <QFuture>
+#include <QMutex>
+#include <QRect>
+#include <QString>
+
+#include <atomic>
+#include <vector>
+
+#include "Common.h"
+#include "FractalRect.h"
+
+// Keeps the iteration counts of finished tiles around, so that going back to a view we've already rendered (switching
+// between the Mandelbrot and Julia sets, zooming back out, or starting the app again) only has to read them back. The
+// most recently used tiles stay in memory, and every tile is also written to the disk cache, which gets trimmed back
+// to its budget (oldest files first) when the cache is created and every so often after that.
+class TileCache
+{
+public:
+    // everything that goes into the iteration counts of a tile
+    struct Key
+    {
+        Formula formula{Formula::Mandelbrot};
+        // only part of the key for Julia sets
+        complex juliaConstant;
+        int maxIterations{0};
+        FractalRect view;
+        QRect tile;
+        // anything else that changes the results, e.g. the render mode; it's just hashed along with the rest
+        QByteArray variant;
+    };
+
+    // an empty directory keeps the cache in memory only
+    explicit TileCache(qint64 memoryBytes = 256 << 20, qint64 diskBytes = qint64{1} << 30, const QString &directory = defaultDirectory());
+    ~TileCache();
+
+    // the tiles folder in the app's cache location
+    static QString defaultDirectory();
+
+    // turns a key into the name its tile is stored under; the tile is identified by the exact coordinates of its top
+    // left pixel and the pixel spacing, so the same tile is found again from any view that has it in the same place
+    static QByteArray hash(const Key &key);
+
+    // fills values with the tile stored under hash, row by row, and returns whether there was one
+    bool find(const QByteArray &hash, const QSize &size, std::vector<float> &values);
+    // stores a finished tile; values holds its rows one after the other
+    void insert(const QByteArray &hash, const QSize &size, const std::vector<float> &values);
+
+private:
+    QString fileName(const QByteArray &hash) const;
+    // deletes the oldest tiles until the disk cache fits into m_diskBytes again
+    void trimDisk();
+
+    QString m_directory;
+    qint64 m_diskBytes;
+
+    QMutex m_mutex;
+    // the cost of each entry is its size in KiB
+    QCache<QByteArray, std::vector<float>> m_memory;
+    QFuture<void> m_trimming;
+    // how much has been written to disk since the last trim
+    std::atomic<qint64> m_written{0};
+};
+
+#endif // TILECACHE_H
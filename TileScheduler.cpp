@@ -0,0 +1,106 @@
+#include "TileScheduler.h"
+
+#include <QtConcurrent>
+
+#include <algorithm>
+
+template<typename Container>
+static void sortByDistance(Container &tiles, const QPointF &focus)
+{
+    auto distance = [&focus](const QRect &tile) {
+        const QPointF offset = QRectF{tile}.center() - focus;
+        return offset.x() * offset.x() + offset.y() * offset.y();
+    };
+    std::sort(tiles.begin(), tiles.end(), [&distance](const QRect &a, const QRect &b) { return distance(a) < distance(b); });
+}
+
+QVector<QRect> TileScheduler::tiles(const QSize &size)
+{
+    QVector<QRect> tiles;
+    for (int y = 0; y < size.height(); y += tileSize)
+        for (int x = 0; x < size.width(); x += tileSize)
+            tiles.push_back(QRect{x, y, std::min(tileSize, size.width() - x), std::min(tileSize, size.height() - y)});
+    return tiles;
+}
+
+QPointF TileScheduler::focus()
+{
+    m_mutex.lock();
+    const auto focus = m_focus;
+    m_mutex.unlock();
+    return focus;
+}
+
+void TileScheduler::setFocus(const QPointF &focus)
+{
+    m_mutex.lock();
+    m_focus = focus;
+    for (auto &queue : m_queues)
+    {
+        queue->mutex.lock();
+        sortByDistance(queue->tiles, m_focus);
+        queue->mutex.unlock();
+    }
+    m_mutex.unlock();
+}
+
+void TileScheduler::run(const QVector<QRect> &tiles, int threadCount, const std::function<void(const QRect &tile)> &work)
+{
+    threadCount = std::max(1, std::min(threadCount, static_cast<int>(tiles.size())));
+
+    // deal the tiles out in order of distance, so that every worker starts off close to the focus
+    m_mutex.lock();
+    auto sorted = tiles;
+    sortByDistance(sorted, m_focus);
+    for (int i = 0; i < threadCount; ++i)
+        m_queues.push_back(std::make_unique<Queue>());
+    for (int i = 0; i < sorted.size(); ++i)
+        m_queues[i % threadCount]->tiles.push_back(sorted[i]);
+    m_mutex.unlock();
+
+    // the calling thread is usually a pool thread itself, so it pitches in instead of just waiting
+    QVector<QFuture<void>> helpers;
+    for (int worker = 1; worker < threadCount; ++worker)
+        helpers.push_back(QtConcurrent::run([this, worker, &work] { this->work(worker, work); }));
+    this->work(0, work);
+    for (auto &helper : helpers)
+        helper.waitForFinished();
+
+    m_mutex.lock();
+    m_queues.clear();
+    m_mutex.unlock();
+}
+
+void TileScheduler::work(int worker, const std::function<void(const QRect &tile)> &work)
+{
+    QRect tile;
+    while (take(worker, tile))
+        work(tile);
+}
+
+bool TileScheduler::take(int worker, QRect &tile)
+{
+    // the queues only ever shrink while the workers run, so once every one of them is empty we're done
+    const int queues = static_cast<int>(m_queues.size());
+    for (int i = 0; i < queues; ++i)
+    {
+        auto &queue = *m_queues[(worker + i) % queues];
+        queue.mutex.lock();
+        const bool found = !queue.tiles.empty();
+        // our own queue gets worked from the front, other workers' queues get robbed from the back
+        if (found && i == 0)
+        {
+            tile = queue.tiles.front();
+            queue.tiles.pop_front();
+        }
+        else if (found)
+        {
+            tile = queue.tiles.back();
+            queue.tiles.pop_back();
+        }
+        queue.mutex.unlock();
+        if (found)
+            return true;
+    }
+    return false;
+}
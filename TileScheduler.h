@@ -0,0 +1,50 @@
+#ifndef TILESCHEDULER_H
+#define TILESCHEDULER_H
+
+#include <QMutex>
+#include <QPointF>
+#include <QRect>
+#include <QVector>
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// Hands the tiles of a render out to a set of worker threads. Every worker has its own queue of tiles, sorted so that
+// the ones closest to the focus point come first, and a worker that runs out of tiles steals from the far end of
+// somebody else's queue. Tiles on the inside of the set cost orders of magnitude more than the ones around it, so this
+// keeps every core busy right up to the end of the frame.
+class TileScheduler
+{
+public:
+    static constexpr int tileSize = 64;
+
+    // cuts an image of the given size up into tiles of tileSize x tileSize pixels (smaller along the right and bottom
+    // edges)
+    static QVector<QRect> tiles(const QSize &size);
+
+    QPointF focus();
+    // moves the focus, which reorders the tiles that haven't been handed out yet; this is safe to call mid-render
+    void setFocus(const QPointF &focus);
+
+    // calls work for every tile from threadCount threads, one of which is the calling thread, and returns once all of
+    // the tiles are done
+    void run(const QVector<QRect> &tiles, int threadCount, const std::function<void(const QRect &tile)> &work);
+
+private:
+    struct Queue
+    {
+        QMutex mutex;
+        std::deque<QRect> tiles;
+    };
+
+    void work(int worker, const std::function<void(const QRect &tile)> &work);
+    bool take(int worker, QRect &tile);
+
+    QMutex m_mutex;
+    QPointF m_focus;
+    std::vector<std::unique_ptr<Queue>> m_queues;
+};
+
+#endif // TILESCHEDULER_H
@@ -0,0 +1,203 @@
+#include "ZoomAnimation.h"
+
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <vector>
+
+#include "Formulas.h"
+
+namespace
+{
+struct Tap
+{
+    int index;
+    float weight;
+};
+
+// the source pixels each of count pixels covers when [start, start + extent) of a row (or column) of sourceCount
+// pixels gets squeezed into them, weighted by how much of each one they cover
+std::vector<std::vector<Tap>> boxFilter(double start, double extent, int count, int sourceCount)
+{
+    std::vector<std::vector<Tap>> taps(count);
+    const double step = extent / count;
+    for (int i = 0; i < count; ++i)
+    {
+        const double from = start + i * step;
+        const double to = from + step;
+        for (int source = static_cast<int>(std::floor(from)); source < to; ++source)
+        {
+            const double covered = std::min<double>(to, source + 1) - std::max<double>(from, source);
+            if (covered > 0)
+                taps[i].push_back({std::clamp(source, 0, sourceCount - 1), static_cast<float>(covered / step)});
+        }
+    }
+    return taps;
+}
+
+// how big a key frame that shows scale times as much as a frame has to be; it keeps the parity of the frame's size so
+// that the deepest frame it covers lines up with its pixels and gets copied over as is
+int keyFrameSize(int frameSize, double scale)
+{
+    return frameSize + 2 * static_cast<int>(std::ceil((frameSize * scale - frameSize) / 2));
+}
+}
+
+ZoomAnimation::ZoomAnimation(const Settings &settings)
+    : m_settings{settings},
+      m_frameZoom{1}
+{
+    m_settings.frameCount = std::max(m_settings.frameCount, 1);
+    m_settings.keyFrameScale = std::max(m_settings.keyFrameScale, 1.0);
+
+    const auto &frame = m_settings.frame;
+    const QSize &size = frame.size;
+    const big_float &startWidth = m_settings.startWidth;
+    // every frame zoomed in from this gets as many digits as it needs on its own, see FractalRect::zoomed()
+    m_startView = FractalRect::centered(frame.center, startWidth, QRectF{0, 0, static_cast<qreal>(size.width()), static_cast<qreal>(size.height())});
+
+    if (m_settings.frameCount > 1)
+    {
+        m_frameZoom = boost::multiprecision::pow(big_float{frame.width / startWidth}, big_float{1} / (m_settings.frameCount - 1));
+        // a key frame covers as many frames as it takes to zoom in by keyFrameScale; zooming out gets no key frames
+        const double zoomPerFrame = -boost::multiprecision::log(m_frameZoom).convert_to<double>();
+        if (zoomPerFrame > 0)
+            m_keyFrameInterval = std::min(1 + static_cast<int>(std::log(m_settings.keyFrameScale) / zoomPerFrame), m_settings.frameCount);
+    }
+
+    // the orbit only depends on the center and the budget, so one calculated for the deepest frame's budget serves
+    // every key frame; the shallow ones need it in double, the deep ones in long double (see ViewPerturbation)
+    auto deepest = frameView(m_settings.frameCount - 1);
+    if (usesPerturbation(frame.formula, frame.deepZoom, deepest.requiredPrecision()))
+    {
+        const int maxIterations = iterationsFor(deepest.width());
+        // the orbit has to be as precise as the deepest frame, not whatever precision the settings got parsed with,
+        // so its reference comes from that frame's view at the digits BatchRenderer gives it
+        deepest.setPrecision(deepest.requiredDigits());
+        const auto reference = ViewPerturbation::referencePoint(deepest);
+        if (!needsExtendedOffsets(big_float{m_startView.width() / size.width()}))
+            m_orbit = std::make_shared<const ReferenceOrbit<double>>(frame.formula, reference, frame.juliaConstant, maxIterations);
+        if (needsExtendedOffsets(big_float{deepest.width() / size.width()}))
+            m_extendedOrbit = std::make_shared<const ReferenceOrbit<long double>>(frame.formula, reference, frame.juliaConstant,
+                                                                                   maxIterations);
+    }
+}
+
+FractalRect ZoomAnimation::frameView(int frame) const
+{
+    return m_startView.zoomed(boost::multiprecision::pow(m_frameZoom, frame));
+}
+
+int ZoomAnimation::keyFrameCount() const
+{
+    return (m_settings.frameCount + m_keyFrameInterval - 1) / m_keyFrameInterval;
+}
+
+bool ZoomAnimation::render(const std::function<bool(int frame, const QImage &image)> &writeFrame)
+{
+    std::atomic<bool> failed{false};
+    std::vector<QFuture<void>> cutting;
+    auto finishCutting = [&cutting] {
+        for (auto &future : cutting)
+            future.waitForFinished();
+        cutting.clear();
+    };
+
+    for (int first = 0; first < m_settings.frameCount && !failed; first += m_keyFrameInterval)
+    {
+        const int last = std::min(first + m_keyFrameInterval, m_settings.frameCount) - 1;
+        const QImage keyFrame = renderKeyFrame(first, last);
+
+        // the frames of the previous key frame had the whole time this one took to render, so this rarely waits, and
+        // it means there are never more than two key frames around at once
+        finishCutting();
+        for (int frame = first; frame <= last; ++frame)
+        {
+            cutting.push_back(QtConcurrent::run([this, &writeFrame, &failed, keyFrame, frame, last] {
+                if (!failed && !writeFrame(frame, cutFrame(keyFrame, frame, last)))
+                    failed = true;
+            }));
+        }
+    }
+    finishCutting();
+
+    return !failed;
+}
+
+int ZoomAnimation::iterationsFor(const big_float &width) const
+{
+    return m_settings.autoIterations ? autoIterationBudget(width) : m_settings.frame.maxIterations;
+}
+
+QImage ZoomAnimation::renderKeyFrame(int firstFrame, int lastFrame) const
+{
+    const QSize &size = m_settings.frame.size;
+    const auto deepest = frameView(lastFrame);
+    const double scale = big_float{frameView(firstFrame).width() / deepest.width()}.convert_to<double>();
+
+    BatchRenderer::Settings settings = m_settings.frame;
+    settings.size = QSize{keyFrameSize(size.width(), scale), keyFrameSize(size.height(), scale)};
+    settings.width = deepest.width() / size.width() * settings.size.width();
+    settings.maxIterations = iterationsFor(deepest.width());
+    settings.orbit = m_orbit;
+    settings.extendedOrbit = m_extendedOrbit;
+
+    QImage image{settings.size, QImage::Format_RGB32};
+    int row = 0;
+    BatchRenderer{settings}.render([&image, &row, width = settings.size.width()](const QRgb *pixels, const float *) {
+        std::copy(pixels, pixels + width, reinterpret_cast<QRgb *>(image.scanLine(row++)));
+        return true;
+    });
+    return image;
+}
+
+QImage ZoomAnimation::cutFrame(const QImage &keyFrame, int frame, int lastFrame) const
+{
+    const QSize &size = m_settings.frame.size;
+    // how much of the key frame this frame shows, in frames
+    const double scale = big_float{frameView(frame).width() / frameView(lastFrame).width()}.convert_to<double>();
+    const double sourceWidth = size.width() * scale;
+    const double sourceHeight = size.height() * scale;
+    const auto columns = boxFilter((keyFrame.width() - sourceWidth) / 2, sourceWidth, size.width(), keyFrame.width());
+    const auto rows = boxFilter((keyFrame.height() - sourceHeight) / 2, sourceHeight, size.height(), keyFrame.height());
+    const int firstColumn = columns.front().front().index;
+    const int lastColumn = columns.back().back().index;
+
+    // the box filter is separable, so every row of the frame first averages the key frame rows it covers and then
+    // squeezes that row into the frame's columns
+    QImage image{size, QImage::Format_RGB32};
+    std::vector<float> line(static_cast<size_t>(keyFrame.width()) * 3);
+    for (int y = 0; y < size.height(); ++y)
+    {
+        std::fill(line.begin() + firstColumn * 3, line.begin() + (lastColumn + 1) * 3, 0.0f);
+        for (const auto &tap : rows[y])
+        {
+            const auto source = reinterpret_cast<const QRgb *>(keyFrame.constScanLine(tap.index));
+            for (int x = firstColumn; x <= lastColumn; ++x)
+            {
+                line[x * 3] += tap.weight * qRed(source[x]);
+                line[x * 3 + 1] += tap.weight * qGreen(source[x]);
+                line[x * 3 + 2] += tap.weight * qBlue(source[x]);
+            }
+        }
+
+        auto target = reinterpret_cast<QRgb *>(image.scanLine(y));
+        for (int x = 0; x < size.width(); ++x)
+        {
+            float red = 0;
+            float green = 0;
+            float blue = 0;
+            for (const auto &tap : columns[x])
+            {
+                red += tap.weight * line[tap.index * 3];
+                green += tap.weight * line[tap.index * 3 + 1];
+                blue += tap.weight * line[tap.index * 3 + 2];
+            }
+            target[x] = qRgb(std::clamp(static_cast<int>(red + 0.5f), 0, 255), std::clamp(static_cast<int>(green + 0.5f), 0, 255),
+                             std::clamp(static_cast<int>(blue + 0.5f), 0, 255));
+        }
+    }
+    return image;
+}
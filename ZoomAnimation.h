@@ -0,0 +1,66 @@
+#ifndef ZOOMANIMATION_H
+#define ZOOMANIMATION_H
+
+#include <QImage>
+
+#include <functional>
+#include <memory>
+
+#include "BatchRenderer.h"
+#include "FractalRect.h"
+#include "Perturbation.h"
+
+// Renders a zoom into a point as a sequence of frames, for the fracture-render tool. The center stays put while the
+// width shrinks by the same factor every frame, from startWidth down to the width of the last frame.
+//
+// Consecutive frames mostly show the same area, so only every few frames (the key frames) actually get calculated:
+// each key frame is rendered larger than the output at the pixel spacing of the deepest frame it covers, and the
+// frames up to that one are cut out of it and scaled down. The reference orbit for deep zooms only depends on the
+// center, so it's calculated once for the deepest frame and shared by every key frame.
+class ZoomAnimation
+{
+public:
+    struct Settings
+    {
+        // the last frame; its center is the point the animation zooms into
+        BatchRenderer::Settings frame;
+        // the width the first frame spans along the real axis
+        big_float startWidth{4};
+        int frameCount{300};
+        // how much bigger than a frame a key frame may get; bigger key frames mean fewer of them, but each takes
+        // longer and everything in between gets more blurry
+        double keyFrameScale{2};
+        // pick every key frame's iteration budget from its zoom depth instead of using frame.maxIterations throughout
+        bool autoIterations{true};
+    };
+
+    explicit ZoomAnimation(const Settings &settings);
+
+    // the view of a single frame
+    FractalRect frameView(int frame) const;
+    int keyFrameCount() const;
+
+    // renders every frame and hands it to writeFrame. Frames are cut out of a key frame on separate threads while the
+    // next key frame is calculated, so writeFrame gets called concurrently and in no particular order. Returns false
+    // as soon as writeFrame does.
+    bool render(const std::function<bool(int frame, const QImage &image)> &writeFrame);
+
+private:
+    int iterationsFor(const big_float &width) const;
+    // renders the key frame at the spacing of lastFrame that covers everything from firstFrame in
+    QImage renderKeyFrame(int firstFrame, int lastFrame) const;
+    // scales the middle part of keyFrame that frame shows down to the output size
+    QImage cutFrame(const QImage &keyFrame, int frame, int lastFrame) const;
+
+    Settings m_settings;
+    // the first frame's view; the others are zoomed in from it
+    FractalRect m_startView;
+    // how much each frame zooms in on the one before it
+    big_float m_frameZoom;
+    int m_keyFrameInterval{1};
+
+    std::shared_ptr<const ReferenceOrbit<double>> m_orbit;
+    std::shared_ptr<const ReferenceOrbit<long double>> m_extendedOrbit;
+};
+
+#endif // ZOOMANIMATION_H
@@ -5,6 +5,7 @@
 #include <QTranslator>
 
 #include "FractalView.h"
+#include "JuliaPreview.h"
 
 int main(int argc, char *argv[])
 {
@@ -31,6 +32,7 @@ int main(int argc, char *argv[])
     }
 
     qmlRegisterType<FractalView>("fracture", 1, 0, "FractalView");
+    qmlRegisterType<JuliaPreview>("fracture", 1, 0, "JuliaPreview");
 
     QQmlApplicationEngine engine;
     const QUrl url(QStringLiteral("qrc:/main.qml"));
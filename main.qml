@@ -29,6 +29,15 @@ ApplicationWindow {
         onAccepted: fractalView.saveImage(file)
     }
 
+    FileDialog {
+        id: traceDialog
+
+        defaultSuffix: "json"
+        nameFilters: "Chrome traces (*.json)"
+        fileMode: FileDialog.SaveFile
+        onAccepted: fractalView.saveTrace(file)
+    }
+
     RowLayout {
         anchors.fill: parent
         anchors.margins: 10
@@ -51,36 +60,116 @@ ApplicationWindow {
             Button {
                 text: qsTr("Save")
                 onClicked: fileDialog.open()
-                enabled: !fractalView.isLoading
+                enabled: !fractalView.isLoading && !fractalView.isSaving
+            }
+
+            Label {
+                text: qsTr("Samples on edges")
+            }
+
+            SpinBox {
+                from: 1
+                to: 256
+                editable: true
+                value: fractalView.exportSamples
+                onValueModified: fractalView.exportSamples = value
             }
 
             ButtonGroup {
-                buttons: fractalTypeButtons.children
+                id: fractalTypeButtons
+
                 exclusive: true
             }
 
             ColumnLayout {
-                id: fractalTypeButtons
-
                 spacing: 10
 
-                RadioButton {
-                    text: qsTr("Mandelbrot")
-                    onClicked: fractalView.type = FractalView.Mandelbrot
-                    checked: fractalView.type === FractalView.Mandelbrot
-                }
+                // one button for every formula FractalView knows
+                Repeater {
+                    model: fractalView.formulas
 
-                RadioButton {
-                    text: qsTr("Julia")
-                    onClicked: fractalView.type = FractalView.Julia
-                    checked: fractalView.type === FractalView.Julia
+                    RadioButton {
+                        text: modelData.label
+                        ButtonGroup.group: fractalTypeButtons
+                        onClicked: fractalView.type = index
+                        checked: fractalView.type === index
+                    }
                 }
+            }
 
-                RadioButton {
-                    text: qsTr("Burning ship")
-                    onClicked: fractalView.type = FractalView.BurningShip
-                    checked: fractalView.type === FractalView.BurningShip
-                }
+            CheckBox {
+                text: qsTr("Deep zoom")
+                checked: fractalView.deepZoom
+                onToggled: fractalView.deepZoom = checked
+            }
+
+            Label {
+                text: qsTr("%1\n~%2x the cost of double").arg(fractalView.precision).arg(fractalView.precisionCost.toFixed(0))
+            }
+
+            ComboBox {
+                // the order here has to match FractalView.ColorScheme
+                model: [qsTr("Classic"), qsTr("Fire"), qsTr("Ocean"), qsTr("Grayscale")]
+                currentIndex: fractalView.colorScheme
+                onActivated: fractalView.colorScheme = index
+            }
+
+            CheckBox {
+                text: qsTr("Smooth coloring")
+                checked: fractalView.smoothColoring
+                onToggled: fractalView.smoothColoring = checked
+            }
+
+            Label {
+                text: qsTr("Max iterations")
+            }
+
+            SpinBox {
+                from: 1
+                to: 1000000
+                stepSize: 50
+                editable: true
+                value: fractalView.maxIterations
+                // setting a budget by hand switches the auto mode off
+                onValueModified: fractalView.maxIterations = value
+            }
+
+            CheckBox {
+                text: qsTr("Auto iterations")
+                checked: fractalView.autoIterations
+                onToggled: fractalView.autoIterations = checked
+            }
+
+            ComboBox {
+                // the order here has to match FractalView.RenderMode
+                model: [qsTr("Brute force"), qsTr("Mariani-Silver"), qsTr("Buddhabrot"), qsTr("Anti-Buddhabrot")]
+                currentIndex: fractalView.renderMode
+                onActivated: fractalView.renderMode = index
+            }
+
+            CheckBox {
+                text: qsTr("Verify fill")
+                checked: fractalView.verifyFill
+                onToggled: fractalView.verifyFill = checked
+                visible: fractalView.renderMode === FractalView.MarianiSilver
+            }
+
+            Label {
+                text: qsTr("%n mismatched pixel(s)", "", fractalView.fillMismatches)
+                visible: fractalView.renderMode === FractalView.MarianiSilver && fractalView.verifyFill && !fractalView.isLoading
+            }
+
+            CheckBox {
+                text: qsTr("Render stats")
+                checked: fractalView.telemetry
+                onToggled: fractalView.telemetry = checked
+            }
+
+            Button {
+                text: qsTr("Save trace")
+                onClicked: traceDialog.open()
+                visible: fractalView.telemetry
+                enabled: !fractalView.isLoading
             }
         }
 
@@ -132,42 +221,43 @@ ApplicationWindow {
 
             Shortcut {
                 sequence: "Left"
-                onActivated: fractalView.xOffset -= 20
+                // without a zoom box to move around, the arrows move the view itself
+                onActivated: fractalView.zoomFactor === 1 ? fractalView.pan(-20, 0) : fractalView.xOffset -= 20
             }
 
             Shortcut {
                 sequence: "Right"
-                onActivated: fractalView.xOffset += 20
+                onActivated: fractalView.zoomFactor === 1 ? fractalView.pan(20, 0) : fractalView.xOffset += 20
             }
 
             Shortcut {
                 sequence: "Up"
-                onActivated: fractalView.yOffset -= 20
+                onActivated: fractalView.zoomFactor === 1 ? fractalView.pan(0, -20) : fractalView.yOffset -= 20
             }
 
             Shortcut {
                 sequence: "Down"
-                onActivated: fractalView.yOffset += 20
+                onActivated: fractalView.zoomFactor === 1 ? fractalView.pan(0, 20) : fractalView.yOffset += 20
             }
 
             Shortcut {
                 sequence: "Shift+Left"
-                onActivated: fractalView.xOffset -= 1
+                onActivated: fractalView.zoomFactor === 1 ? fractalView.pan(-1, 0) : fractalView.xOffset -= 1
             }
 
             Shortcut {
                 sequence: "Shift+Right"
-                onActivated: fractalView.xOffset += 1
+                onActivated: fractalView.zoomFactor === 1 ? fractalView.pan(1, 0) : fractalView.xOffset += 1
             }
 
             Shortcut {
                 sequence: "Shift+Up"
-                onActivated: fractalView.yOffset -= 1
+                onActivated: fractalView.zoomFactor === 1 ? fractalView.pan(0, -1) : fractalView.yOffset -= 1
             }
 
             Shortcut {
                 sequence: "Shift+Down"
-                onActivated: fractalView.yOffset += 1
+                onActivated: fractalView.zoomFactor === 1 ? fractalView.pan(0, 1) : fractalView.yOffset += 1
             }
 
             Shortcut {
@@ -179,13 +269,62 @@ ApplicationWindow {
             TapHandler {
                 acceptedButtons: Qt.LeftButton
                 onTapped: {
-                    if (fractalView.type === FractalView.Mandelbrot)
+                    var mandelbrot = fractalView.formulaIndex("mandelbrot")
+                    var julia = fractalView.formulaIndex("julia")
+                    if (fractalView.type === mandelbrot)
                     {
                         fractalView.juliaPoint = eventPoint.position
-                        fractalView.type = FractalView.Julia
+                        fractalView.type = julia
                     }
-                    else if (fractalView.type === FractalView.Julia)
-                        fractalView.type = FractalView.Mandelbrot
+                    else if (fractalView.type === julia)
+                        fractalView.type = mandelbrot
+                }
+            }
+
+            HoverHandler {
+                id: hover
+
+                // the preview follows the cursor around the Mandelbrot set; clicking picks the constant it shows
+                onPointChanged: {
+                    if (juliaPreviewBox.visible)
+                        juliaPreview.constant = fractalView.fractalPoint(point.position)
+                }
+            }
+
+            Rectangle {
+                id: juliaPreviewBox
+
+                // stay out of the cursor's way by moving to whichever side it isn't on
+                x: hover.point.position.x < parent.width / 2 ? parent.width - width - 5 : 5
+                anchors.bottom: parent.bottom
+                anchors.margins: 5
+                width: 250
+                height: 250 + juliaConstant.implicitHeight
+                radius: 5
+                color: "black"
+                visible: hover.hovered && fractalView.type === fractalView.formulaIndex("mandelbrot")
+
+                JuliaPreview {
+                    id: juliaPreview
+
+                    anchors.top: parent.top
+                    anchors.horizontalCenter: parent.horizontalCenter
+                    anchors.topMargin: 5
+                    width: 240
+                    height: 240
+                    colorScheme: fractalView.colorScheme
+                }
+
+                Text {
+                    id: juliaConstant
+
+                    anchors.top: juliaPreview.bottom
+                    anchors.horizontalCenter: parent.horizontalCenter
+                    color: "white"
+                    font.family: "monospace"
+                    text: qsTr("%1 %2 %3i").arg(juliaPreview.constant.x.toFixed(6))
+                                          .arg(juliaPreview.constant.y < 0 ? "-" : "+")
+                                          .arg(Math.abs(juliaPreview.constant.y).toFixed(6))
                 }
             }
 
@@ -203,6 +342,33 @@ ApplicationWindow {
                 height: parent.height * fractalView.zoomFactor
             }
 
+            Rectangle {
+                anchors.top: parent.top
+                anchors.right: parent.right
+                anchors.margins: 5
+                width: statsText.implicitWidth + 10
+                height: statsText.implicitHeight + 10
+                radius: 5
+                color: "black"
+                opacity: 0.7
+                visible: fractalView.telemetry
+
+                Text {
+                    id: statsText
+
+                    anchors.centerIn: parent
+                    color: "white"
+                    font.family: "monospace"
+                    // density renders iterate orbits rather than pixels
+                    text: qsTr("%1 ms\n%2\n%3 Giter/s\n%4% thread utilization")
+                          .arg(fractalView.frameMilliseconds.toFixed(1))
+                          .arg(fractalView.megasamplesPerSecond > 0 ? qsTr("%1 Msamples/s").arg(fractalView.megasamplesPerSecond.toFixed(2))
+                                                                    : qsTr("%1 Mpix/s").arg(fractalView.megapixelsPerSecond.toFixed(2)))
+                          .arg(fractalView.gigaiterationsPerSecond.toFixed(3))
+                          .arg((fractalView.threadUtilization * 100).toFixed(0))
+                }
+            }
+
             Rectangle {
                 id: loadingBubble
 